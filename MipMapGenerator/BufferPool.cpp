@@ -0,0 +1,182 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "BufferPool.h"
+
+namespace {
+
+// Blocks of each class a thread keeps for itself, the rest go to the shared lists
+const size_t kThreadCacheBlocks = 4;
+// Bytes of the blocks a thread keeps at most, whatever their classes: the large ones (levels, chains) go
+// to the shared lists, where any thread can take them and they count against kMaxSharedBytes
+const size_t kMaxThreadCacheBytes = size_t(4) << 20;
+// Bytes the shared lists keep at most, past them released blocks go back to the system
+const size_t kMaxSharedBytes = size_t(1) << 30;
+
+// Stored right before each block
+struct BlockHeader {
+    // What malloc returned
+    void* allocation;
+    int size_class;
+};
+
+size_t classSize(int size_class) {
+    if (size_class == 0) {
+        return 256;
+    }
+    // 5, 6, 7 and 8 quarters of 2^shift, shift from 8
+    const int shift = 8 + (size_class - 1) / 4;
+    const size_t quarters = 5 + (size_class - 1) % 4;
+    return quarters << (shift - 2);
+}
+
+int sizeClass(size_t bytes) {
+    if (bytes <= 256) {
+        return 0;
+    }
+    // Past the largest class (or half the address space of 32 bit builds) the search below would shift out of
+    // size_t and never end
+    const size_t max_bytes = sizeof(size_t) > 4 ? classSize(BufferPool::kClasses - 1) : size_t(1) << 31;
+    if (bytes > max_bytes) {
+        throw std::bad_alloc();
+    }
+    // 2^shift < bytes <= 2^(shift + 1)
+    int shift = 0;
+    while ((size_t(2) << shift) < bytes) {
+        shift++;
+    }
+    const size_t quarter = size_t(1) << (shift - 2);
+    const size_t quarters = (bytes + quarter - 1) / quarter;
+    return (shift - 8) * 4 + static_cast<int>(quarters) - 4;
+}
+
+BlockHeader& header(const unsigned char* block) {
+    return *reinterpret_cast<BlockHeader*>(const_cast<unsigned char*>(block) - sizeof(BlockHeader));
+}
+
+} // namespace
+
+// Blocks released by a thread, taken again by its next requests without locking.
+// They go to the shared lists when the thread ends
+struct ThreadCache {
+    std::vector<unsigned char*> blocks[BufferPool::kClasses];
+    // Bytes of the blocks
+    size_t bytes{ 0 };
+
+    ~ThreadCache() {
+        for (int c = 0; c < BufferPool::kClasses; c++) {
+            for (unsigned char* block : blocks[c]) {
+                BufferPool::instance().releaseShared(block, c);
+            }
+        }
+    }
+};
+
+namespace {
+
+ThreadCache& threadCache() {
+    thread_local ThreadCache cache;
+    return cache;
+}
+
+} // namespace
+
+BufferPool& BufferPool::instance() {
+    static BufferPool pool;
+    return pool;
+}
+
+unsigned char* BufferPool::allocate(size_t bytes) {
+    const int size_class = sizeClass(bytes);
+    ThreadCache& cache = threadCache();
+    std::vector<unsigned char*>& cached = cache.blocks[size_class];
+    if (!cached.empty()) {
+        unsigned char* block = cached.back();
+        cached.pop_back();
+        cache.bytes -= classSize(size_class);
+        return block;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mFree[size_class].empty()) {
+            unsigned char* block = mFree[size_class].back();
+            mFree[size_class].pop_back();
+            mFreeBytes -= classSize(size_class);
+            return block;
+        }
+    }
+    // Room for the header and for aligning the block after it
+    void* allocation = std::malloc(classSize(size_class) + 2 * kAlignment);
+    if (allocation == nullptr) {
+        throw std::bad_alloc();
+    }
+    mSystemAllocations++;
+    const uintptr_t address = reinterpret_cast<uintptr_t>(allocation) + kAlignment;
+    unsigned char* block = reinterpret_cast<unsigned char*>(address - address % kAlignment + kAlignment);
+    header(block) = BlockHeader{ allocation, size_class };
+    return block;
+}
+
+unsigned char* BufferPool::reallocate(unsigned char* block, size_t bytes) {
+    if (block != nullptr && capacity(block) >= bytes) {
+        return block;
+    }
+    unsigned char* larger = allocate(bytes);
+    if (block != nullptr) {
+        std::memcpy(larger, block, capacity(block));
+        release(block);
+    }
+    return larger;
+}
+
+void BufferPool::release(unsigned char* block) {
+    if (block == nullptr) {
+        return;
+    }
+    const int size_class = header(block).size_class;
+    ThreadCache& cache = threadCache();
+    std::vector<unsigned char*>& cached = cache.blocks[size_class];
+    if (cached.size() < kThreadCacheBlocks && cache.bytes + classSize(size_class) <= kMaxThreadCacheBytes) {
+        // Reserved at once, the cache never allocates again
+        cached.reserve(kThreadCacheBlocks);
+        cached.push_back(block);
+        cache.bytes += classSize(size_class);
+        return;
+    }
+    releaseShared(block, size_class);
+}
+
+size_t BufferPool::capacity(const unsigned char* block) {
+    return classSize(header(block).size_class);
+}
+
+void BufferPool::trim() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (std::vector<unsigned char*>& blocks : mFree) {
+        for (unsigned char* block : blocks) {
+            std::free(header(block).allocation);
+        }
+        blocks.clear();
+    }
+    mFreeBytes = 0;
+}
+
+size_t BufferPool::systemAllocations() const {
+    return mSystemAllocations;
+}
+
+BufferPool::~BufferPool() {
+    trim();
+}
+
+void BufferPool::releaseShared(unsigned char* block, int size_class) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mFreeBytes + classSize(size_class) > kMaxSharedBytes) {
+        std::free(header(block).allocation);
+        return;
+    }
+    mFree[size_class].push_back(block);
+    mFreeBytes += classSize(size_class);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Blocks of memory recycled between the images of a batch: the pixels of ImageData, the block of a MipChain
+// and the buffers stb_image decodes with all come from here. Requests are rounded up to a size class (four
+// per power of two, so at most 25% is wasted) and released blocks wait for the next request of their class,
+// first in a cache of the thread that released them (a few MB at most) and then in lists shared by every
+// thread. Once a batch of textures has seen each size it needs, it runs without calling malloc or free.
+// Blocks are aligned to kAlignment bytes
+class BufferPool {
+public:
+    static const size_t kAlignment = 64;
+    // Size classes: up to 256 bytes, then four per power of two up to 2^40
+    static const int kClasses = 129;
+    // The pool of the process
+    static BufferPool& instance();
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator= (const BufferPool&) = delete;
+    // A block of at least bytes. Throws std::bad_alloc if there is no memory left or bytes is past the largest
+    // size class
+    unsigned char* allocate(size_t bytes);
+    // Same contents as block for its first min(bytes, capacity(block)) bytes, block itself when it is large
+    // enough. Like realloc, a null block allocates
+    unsigned char* reallocate(unsigned char* block, size_t bytes);
+    // Gives a block of allocate back to the pool, null is ignored
+    void release(unsigned char* block);
+    // Usable bytes of a block, the size of its class
+    static size_t capacity(const unsigned char* block);
+    // Frees the blocks waiting in the shared lists, i. e. between batches of different sizes
+    void trim();
+    // Blocks allocated from the system so far, i. e. to check that a batch runs out of the pool
+    size_t systemAllocations() const;
+
+private:
+    std::mutex mMutex;
+    std::vector<unsigned char*> mFree[kClasses];
+    // Bytes of the blocks in mFree, the ones over kMaxSharedBytes go back to the system
+    size_t mFreeBytes{ 0 };
+    std::atomic<size_t> mSystemAllocations{ 0 };
+    // Helper private methods
+    BufferPool() = default;
+    ~BufferPool();
+    friend struct ThreadCache;
+    void releaseShared(unsigned char* block, int size_class);
+};
+
+// Releases the block of a std::unique_ptr to the pool
+struct PoolDeleter {
+    void operator()(unsigned char* block) const {
+        BufferPool::instance().release(block);
+    }
+};
+
+typedef std::unique_ptr<unsigned char, PoolDeleter> PoolBlock;
@@ -0,0 +1,738 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "CPUMipMapGeneration.h"
+#include "CPUMipMapKernels.h"
+
+namespace {
+
+// Maximum number of levels written from a single read of the source (OutMip1..OutMip4 in GenerateMips_CS.hlsl)
+const int kMaxFusedLevels = 4;
+// Width in pixels of the first fused level tile. With 4 levels a tile reads a 16 x 128 block of
+// RGBA source pixels (8 KB) and everything it writes afterwards stays in L1
+const int kFusedTileWidth = 64;
+// Levels finished per tile by generatePyramid with pyramid_tiles, and maximum tile width in pixels of its first level.
+// The source block of a tile is 64 x 2048 RGBA pixels (512 KB) so the tile pyramid stays in L2.
+// Square tiles fit smaller caches but read too many short rows: the prefetcher can not keep up
+// and they end up slower than the fused passes
+const int kPyramidTileLevels = 6;
+const int kPyramidTileWidth = 1024;
+
+// Bands smaller than this (in destination pixels) cost more to schedule than to compute.
+// Small levels end up in a single band that runs on the calling thread
+const int kMinPixelsPerBand = 32 * 1024;
+// More bands than threads so a slow thread does not hold back the whole level
+const int kBandsPerThread = 4;
+// Rows of a band filtered at once when its level is also stored in a layout: they are still in L2 when they
+// are stored (a post filter reduces the rows around them again, 2 of every 32)
+const int kLayoutBandRows = 32;
+
+// Source columns of a tile of the levels resampled from level 0: the vertical pass of 1024 RGBA pixels (16 KB)
+// stays in L1 for the horizontal one. Levels whose horizontal taps take more than a quarter of a tile (the
+// smallest ones) keep the vertical pass of their rows in memory instead
+const int kDirectTileColumns = 1024;
+// Weight tables kept by the generator (one per axis of each image size it resampled to). A pyramid of
+// an 8K texture with both axes different takes 26 of them, a batch of textures of a few sizes reuses them
+const size_t kMaxCachedAxes = 64;
+
+// Pixels of the neighbourhood along one axis of the src texture (GenerateMip.hlsl dimension_case).
+// The kernels (CPUMipMapKernels.inl) are instantiated for every number of columns and rows, so their weights
+// are constants and the loops over the taps unroll
+int tapCount(int src_size) {
+    // A one pixel wide axis (last levels of a non square texture) can only sample itself.
+    // The shader reads outside of the texture in that case
+    if (src_size == 1) {
+        return 1;
+    }
+    // Even: 2 pixels neighbourhood. Odd: 3 pixels neighbourhood
+    return (src_size % 2) == 0 ? 2 : 3;
+}
+
+// How many bands to split rows of row_pixels pixels in
+int bandCount(int rows, int row_pixels, unsigned int num_threads) {
+    const int max_bands = static_cast<int>(num_threads) * kBandsPerThread;
+    return std::max(1, std::min({ rows, max_bands, static_cast<int>(static_cast<long long>(rows) * row_pixels / kMinPixelsPerBand) }));
+}
+
+// Number of pixels of each alpha value
+using AlphaHistogram = std::array<unsigned int, 256>;
+
+// Alpha is the last of the channels of the pixels of rows [first_row, last_row) of image
+void addAlphaHistogram(const ImageView& image, int first_row, int last_row, AlphaHistogram& histogram) {
+    // Four partial histograms, so runs of the same alpha (i. e. fully opaque areas) do not wait on each other
+    unsigned int partial[4][256] = {};
+    const int channels = image.channels;
+    for (int y = first_row; y < last_row; y++) {
+        const unsigned char* alpha = image.row(y) + channels - 1;
+        int i = 0;
+        for (; i + 4 <= image.width; i += 4) {
+            partial[0][alpha[channels * i]]++;
+            partial[1][alpha[channels * (i + 1)]]++;
+            partial[2][alpha[channels * (i + 2)]]++;
+            partial[3][alpha[channels * (i + 3)]]++;
+        }
+        for (; i < image.width; i++) {
+            partial[0][alpha[channels * i]]++;
+        }
+    }
+    for (int a = 0; a < 256; a++) {
+        histogram[a] += partial[0][a] + partial[1][a] + partial[2][a] + partial[3][a];
+    }
+}
+
+bool isNextLevel(const ImageView& src_image, const ImageView& dst_image) {
+    return dst_image.width == (src_image.width > 1 ? src_image.width / 2 : 1) &&
+           dst_image.height == (src_image.height > 1 ? src_image.height / 2 : 1);
+}
+
+// Computes the region [x, x + width) x [y, y + height) of dst_images[0] and the matching regions of the
+// following levels - 1 levels. width and height must be multiples of 2^(levels - 1)
+void reduceTile(const LevelKernel* kernels, const ImageView& src_image, const ImageView* dst_images, int levels,
+                int x, int y, int width, int height) {
+    kernels[0].filter(src_image, dst_images[0], x, x + width, y, y + height);
+    // The rest of the levels come from the tile we just wrote, still in cache
+    for (int l = 1; l < levels; l++) {
+        kernels[l].filter(dst_images[l - 1], dst_images[l], x >> l, (x + width) >> l, y >> l, (y + height) >> l);
+    }
+}
+
+// Stores the region [x, x + width) x [y, y + height) of dst_images[0] and the matching regions of the following
+// levels - 1 levels in their layout, right after reduceTile (or reducePlanarTile) wrote them
+void storeTile(const LayoutLevels& layout, const ImageView* dst_images, int levels, int x, int y, int width, int height) {
+    for (int l = 0; l < levels; l++) {
+        layout.store(l, dst_images[l], x >> l, (x + width) >> l, y >> l, (y + height) >> l);
+    }
+}
+
+// Channel planes of a region of a level, plane c of row y at row(c, y)
+struct Planes {
+    unsigned char* memory;
+    size_t plane_size;
+    int pitch;
+
+    unsigned char* row(int c, int y) const {
+        return memory + c * plane_size + static_cast<size_t>(y) * pitch;
+    }
+};
+
+// Reduces the planes of the source region planes[0], 2 * width x 2 * height pixels, to the region
+// [x, x + width) x [y, y + height) of dst_images[0] and the matching regions of the following levels - 1 levels.
+// planes[1] holds width x height pixels: the two sets take turns, each level is read from the set the one
+// above was written to. The planes of the last level go to last_level instead when it is not null
+void reducePlaneLevels(const MipKernels& kernels, Planes* planes, const ImageView* dst_images, int levels,
+                       int x, int y, int width, int height, const Planes* last_level) {
+    const int channels = dst_images[0].channels;
+    const size_t pixel_bytes = dst_images[0].bytesPerPixel();
+    for (int l = 0; l < levels; l++) {
+        const int level_width = width >> l;
+        const int level_height = height >> l;
+        const Planes& src = planes[l % 2];
+        Planes& next = planes[(l + 1) % 2];
+        next.plane_size = static_cast<size_t>(level_width) * level_height;
+        next.pitch = level_width;
+        const Planes& dst = (l == levels - 1 && last_level != nullptr) ? *last_level : next;
+        for (int c = 0; c < channels; c++) {
+            for (int row = 0; row < level_height; row++) {
+                kernels.box_plane_row(src.row(c, 2 * row), src.row(c, 2 * row + 1), level_width, dst.row(c, row));
+            }
+        }
+        // Interleaved again only to be stored
+        const ImageView& level = dst_images[l];
+        for (int row = 0; row < level_height; row++) {
+            kernels.interleave[channels - 1](dst.row(0, row), dst.plane_size, level_width,
+                                             level.row((y >> l) + row) + (x >> l) * pixel_bytes);
+        }
+    }
+}
+
+// reduceTile in channel planes (see CPUMipMapOptions::planar_tiles): the source block of the tile is split
+// in planes once, then all its levels are reduced plane by plane
+void reducePlanarTile(const MipKernels& kernels, const ImageView& src_image, const ImageView* dst_images, int levels,
+                      int x, int y, int width, int height, const Planes* last_level) {
+    const int channels = src_image.channels;
+    const size_t pixel_bytes = src_image.bytesPerPixel();
+    const size_t level_size = static_cast<size_t>(width) * height;
+    unsigned char* memory = static_cast<unsigned char*>(scratchMemory(5 * level_size * channels));
+    Planes planes[2] = { { memory, 4 * level_size, 2 * width }, { memory + 4 * level_size * channels, level_size, width } };
+    for (int row = 0; row < 2 * height; row++) {
+        kernels.deinterleave[channels - 1](src_image.row(2 * y + row) + 2 * x * pixel_bytes, 2 * width,
+                                           planes[0].row(0, row), planes[0].plane_size);
+    }
+    reducePlaneLevels(kernels, planes, dst_images, levels, x, y, width, height, last_level);
+}
+
+} // namespace
+
+CPUMipMapGenerator::CPUMipMapGenerator(const CPUMipMapOptions& options)
+    : mOptions(options), mThreadPool(options.num_threads), mKernels(&mipKernels()),
+      mPostFilterWeights(postFilterKernel(options.post_filter, options.post_filter_strength != 0.0f ?
+                                          options.post_filter_strength : defaultPostFilterStrength(options.post_filter))),
+      mColorTransform(composeColorOps(options.color_ops)), mHasColorOps(!isIdentity(mColorTransform)) {
+
+}
+
+CPUMipMapGenerator::~CPUMipMapGenerator() {
+
+}
+
+const char* CPUMipMapGenerator::kernelsName() const {
+    return mKernels->name;
+}
+
+bool CPUMipMapGenerator::generateMip(const ImageView& src_image, const ImageView& dst_image) {
+    return generateMips(src_image, &dst_image, 1) == 1;
+}
+
+int CPUMipMapGenerator::generateMips(const ImageView& src_image, const ImageView* dst_images, int max_levels) {
+    return reduceLevels(src_image, dst_images, max_levels, LayoutLevels());
+}
+
+// generateMips, with the levels stored in layout too, dst_images[l] at layout level l
+int CPUMipMapGenerator::reduceLevels(const ImageView& src_image, const ImageView* dst_images, int max_levels,
+                                     const LayoutLevels& layout) {
+    const int levels = fusableLevels(src_image, dst_images, std::min(max_levels, kMaxFusedLevels));
+    LevelKernel kernels[kMaxFusedLevels];
+    for (int l = 0; l < levels; l++) {
+        kernels[l] = levelKernel(l == 0 ? src_image : dst_images[l - 1]);
+    }
+
+    const bool planar = levels > 1 && reducesPlanar(src_image);
+
+    // Split the first level rows in bands of whole tiles.
+    // The dimensions of the first level are multiple of the tile size since all the fused levels are even
+    const int tile_size = 1 << (levels - 1);
+    const ImageView& first_level = dst_images[0];
+    const int tile_rows = first_level.height / tile_size;
+    const int tile_row_pixels = first_level.width * tile_size;
+    const int bands = bandCount(tile_rows, tile_row_pixels, mThreadPool.size());
+    const int tile_rows_per_band = (tile_rows + bands - 1) / bands;
+    mThreadPool.parallelFor(bands, [&](int band) {
+        const int first_row = band * tile_rows_per_band * tile_size;
+        const int last_row = std::min(first_level.height, first_row + tile_rows_per_band * tile_size);
+        if (levels == 1 && !layout.stores(0)) {
+            kernels[0].filter(src_image, dst_images[0], 0, first_level.width, first_row, last_row);
+            return;
+        }
+        if (levels == 1) {
+            for (int y = first_row; y < last_row; y += kLayoutBandRows) {
+                const int last_y = std::min(last_row, y + kLayoutBandRows);
+                kernels[0].filter(src_image, dst_images[0], 0, first_level.width, y, last_y);
+                layout.store(0, dst_images[0], 0, first_level.width, y, last_y);
+            }
+            return;
+        }
+        for (int y = first_row; y < last_row; y += tile_size) {
+            for (int x = 0; x < first_level.width; x += kFusedTileWidth) {
+                const int tile_width = std::min(kFusedTileWidth, first_level.width - x);
+                if (planar) {
+                    reducePlanarTile(*mKernels, src_image, dst_images, levels, x, y, tile_width, tile_size, nullptr);
+                } else {
+                    reduceTile(kernels, src_image, dst_images, levels, x, y, tile_width, tile_size);
+                }
+                storeTile(layout, dst_images, levels, x, y, tile_width, tile_size);
+            }
+        }
+    });
+
+    return levels;
+}
+
+bool CPUMipMapGenerator::resize(const ImageView& src_image, const ImageView& dst_image) {
+    resample(src_image, &dst_image, 1, mOptions.direct_filter != DirectFilter::None ? mOptions.direct_filter : DirectFilter::Lanczos,
+             LayoutLevels());
+    return true;
+}
+
+void CPUMipMapGenerator::generatePyramid(const ImageView* mip_maps, int num_levels, const LayoutLevels& layout_levels) {
+    if (mOptions.preserve_alpha_coverage && mip_maps[0].format != PixelFormat::UNorm8) {
+        throw std::runtime_error("Alpha coverage is only supported for 8 bit images!");
+    }
+    if (mOptions.preserve_alpha_coverage && alphaChannel(mip_maps[0].channels) < 0) {
+        throw std::runtime_error("Alpha coverage needs an image with alpha!");
+    }
+    if (mOptions.direct_filter != DirectFilter::None && mOptions.post_filter != PostFilter::None) {
+        throw std::runtime_error("Post filters only apply to the reduced levels, not to direct filters!");
+    }
+    for (int i = 0; i < num_levels; i++) {
+        if (layout_levels.stores(i) && !fitsLayout(layout_levels.layout, mip_maps[i].width, mip_maps[i].height)) {
+            throw std::runtime_error("The levels do not fit the layout!");
+        }
+    }
+    // Every level is reduced from the transformed level 0, so each one gets the color operations once
+    transformColors(mip_maps[0], layout_levels);
+    // Each tile is stored as soon as it is filtered, while it is still in cache. The alpha coverage changes
+    // the levels once they are all filtered, so they are stored in a pass of their own after it
+    const LayoutLevels filtered_layout = mOptions.preserve_alpha_coverage ? LayoutLevels() : layout_levels;
+    if (mOptions.direct_filter != DirectFilter::None) {
+        resample(mip_maps[0], &mip_maps[1], num_levels - 1, mOptions.direct_filter, filtered_layout.from(1));
+    } else {
+        buildPyramid(mip_maps, num_levels, filtered_layout);
+    }
+    // Every level is filtered from the unscaled one above, the alpha of the outputs is scaled afterwards
+    if (mOptions.preserve_alpha_coverage && num_levels > 1) {
+        const std::array<unsigned long long, 256> histogram = alphaHistogram(mip_maps[0]);
+        unsigned long long covered = 0;
+        for (int a = alphaReference(); a < 256; a++) {
+            covered += histogram[a];
+        }
+        const double coverage = static_cast<double>(covered) / (static_cast<double>(mip_maps[0].width) * mip_maps[0].height);
+        for (int i = 1; i < num_levels; i++) {
+            scaleAlphaToCoverage(mip_maps[i], coverage);
+        }
+        storeLevels(mip_maps, 1, num_levels, layout_levels);
+    }
+}
+
+void CPUMipMapGenerator::generatePyramid(ImageData* mip_maps, int num_levels, const LayoutLevels& layout_levels) {
+    mPyramidViews.assign(mip_maps, mip_maps + num_levels);
+    generatePyramid(mPyramidViews.data(), num_levels, layout_levels);
+}
+
+// Levels stored in layout, mip_maps[l] at layout level l
+void CPUMipMapGenerator::buildPyramid(const ImageView* mip_maps, int num_levels, const LayoutLevels& layout) {
+    const int tile_levels = mOptions.pyramid_tiles ? kPyramidTileLevels : kMaxFusedLevels;
+    for (int i = 1; i < num_levels; ) {
+        const ImageView& src_image = mip_maps[i - 1];
+        const ImageView* dst_images = &mip_maps[i];
+        const int levels = fusableLevels(src_image, dst_images, std::min(num_levels - i, tile_levels));
+        // Shallow pyramids (or the few levels left at the top) are just the fused passes
+        if (levels <= kMaxFusedLevels) {
+            i += reduceLevels(src_image, dst_images, num_levels - i, layout.from(i));
+            continue;
+        }
+
+        // Every tile of tile_width x tile_size pixels of the first level depends only on its own
+        // source block, so we can finish all its levels before we move to the next one.
+        // The first level dimensions are multiple of tile_size, and so is tile_width
+        const int tile_size = 1 << (levels - 1);
+        LevelKernel kernels[kPyramidTileLevels];
+        for (int l = 0; l < levels; l++) {
+            kernels[l] = levelKernel(l == 0 ? src_image : dst_images[l - 1]);
+        }
+        int tile_width = tile_size;
+        while (tile_width * 2 <= kPyramidTileWidth && (dst_images[0].width % (tile_width * 2)) == 0) {
+            tile_width *= 2;
+        }
+        const int block_size = 1 << (kMaxFusedLevels - 1);
+        const int tiles_x = dst_images[0].width / tile_width;
+        const int tiles_y = dst_images[0].height / tile_size;
+        const bool planar = reducesPlanar(src_image);
+        const LayoutLevels tile_layout = layout.from(i);
+        mThreadPool.parallelFor(tiles_x * tiles_y, [&](int tile) {
+            const int tile_x = (tile % tiles_x) * tile_width;
+            const int tile_y = (tile / tiles_x) * tile_size;
+            if (planar) {
+                // The blocks leave the planes of the last fused level of the whole tile in planes[0], the rest of
+                // the levels are reduced from them
+                const int last_fused = kMaxFusedLevels - 1;
+                const size_t fused_size = static_cast<size_t>(tile_width >> last_fused) * (tile_size >> last_fused);
+                const int channels = src_image.channels;
+                unsigned char* memory = static_cast<unsigned char*>(scratchMemory(2 * fused_size * channels, 1));
+                Planes planes[2] = { { memory, fused_size, tile_width >> last_fused },
+                                     { memory + fused_size * channels, fused_size / 4, tile_width >> kMaxFusedLevels } };
+                for (int y = tile_y; y < tile_y + tile_size; y += block_size) {
+                    for (int x = tile_x; x < tile_x + tile_width; x += kFusedTileWidth) {
+                        const Planes block_planes{ planes[0].row(0, (y - tile_y) >> last_fused) + ((x - tile_x) >> last_fused),
+                                                   fused_size, planes[0].pitch };
+                        const int block_width = std::min(kFusedTileWidth, tile_x + tile_width - x);
+                        reducePlanarTile(*mKernels, src_image, dst_images, kMaxFusedLevels, x, y, block_width, block_size, &block_planes);
+                        storeTile(tile_layout, dst_images, kMaxFusedLevels, x, y, block_width, block_size);
+                    }
+                }
+                reducePlaneLevels(*mKernels, planes, &dst_images[kMaxFusedLevels], levels - kMaxFusedLevels,
+                                  tile_x >> kMaxFusedLevels, tile_y >> kMaxFusedLevels,
+                                  tile_width >> kMaxFusedLevels, tile_size >> kMaxFusedLevels, nullptr);
+                storeTile(tile_layout.from(kMaxFusedLevels), &dst_images[kMaxFusedLevels], levels - kMaxFusedLevels,
+                          tile_x >> kMaxFusedLevels, tile_y >> kMaxFusedLevels, tile_width >> kMaxFusedLevels, tile_size >> kMaxFusedLevels);
+                return;
+            }
+            // The first kMaxFusedLevels levels in blocks that fit in L1
+            for (int y = tile_y; y < tile_y + tile_size; y += block_size) {
+                for (int x = tile_x; x < tile_x + tile_width; x += kFusedTileWidth) {
+                    const int block_width = std::min(kFusedTileWidth, tile_x + tile_width - x);
+                    reduceTile(kernels, src_image, dst_images, kMaxFusedLevels, x, y, block_width, block_size);
+                    storeTile(tile_layout, dst_images, kMaxFusedLevels, x, y, block_width, block_size);
+                }
+            }
+            // The rest of them from the tile of the last fused level, still in L2
+            for (int l = kMaxFusedLevels; l < levels; l++) {
+                kernels[l].filter(dst_images[l - 1], dst_images[l], tile_x >> l, (tile_x + tile_width) >> l,
+                                  tile_y >> l, (tile_y + tile_size) >> l);
+            }
+            storeTile(tile_layout.from(kMaxFusedLevels), &dst_images[kMaxFusedLevels], levels - kMaxFusedLevels,
+                      tile_x >> kMaxFusedLevels, tile_y >> kMaxFusedLevels, tile_width >> kMaxFusedLevels, tile_size >> kMaxFusedLevels);
+        });
+        i += levels;
+    }
+}
+
+// Every destination image is split in tasks of (a tile of) a row of its pixels, and the tasks of all of them
+// run in a single parallel loop, the last (smallest) images first: their tasks are the longest and every level
+// of a pyramid costs about the same (its pixels sum the whole source), so no level waits for another.
+// A task sums the decoded source rows of its vertical taps and then filters them horizontally. Levels whose
+// horizontal taps are too wide for a tile (a pixel of the last levels sums thousands of source pixels) keep
+// the vertical pass of their rows, split in tiles of source columns, and a second loop filters them.
+// Each row written is stored in layout too, dst_images[l] at layout level l
+void CPUMipMapGenerator::resample(const ImageView& src_image, const ImageView* dst_images, int count, DirectFilter filter,
+                                  const LayoutLevels& layout) {
+    const RowCodec codec = mKernels->row_codec(mOptions, src_image.format, src_image.channels);
+    const int channels = codec.channels;
+    const size_t pixel_bytes = src_image.bytesPerPixel();
+    struct DirectLevel {
+        const AxisWeights* columns;
+        const AxisWeights* rows;
+        // Destination pixels of a task, 0 when the level keeps its vertical pass
+        int tile_width;
+        int tiles_per_row;
+        // Rows of the vertical pass, source width floats each
+        std::vector<float> vertical;
+    };
+    // First task of each level in a loop, in the order they run
+    struct TaskRange {
+        int level;
+        int first_task;
+    };
+    // The tables of the previous calls may be reused below, they are only dropped here
+    if (mAxisWeights.size() > kMaxCachedAxes) {
+        mAxisWeights.clear();
+    }
+    std::vector<DirectLevel> levels(count);
+    std::vector<TaskRange> tile_tasks;
+    std::vector<TaskRange> row_tasks;
+    int tile_count = 0;
+    int row_count = 0;
+    for (int l = count - 1; l >= 0; l--) {
+        const ImageView& dst_image = dst_images[l];
+        checkLevel(src_image, dst_image);
+        DirectLevel& level = levels[l];
+        level.columns = &cachedAxisWeights(filter, src_image.width, dst_image.width);
+        level.rows = &cachedAxisWeights(filter, src_image.height, dst_image.height);
+        if (level.columns->taps <= kDirectTileColumns / 4) {
+            const double scale = static_cast<double>(src_image.width) / dst_image.width;
+            level.tile_width = std::max(1, static_cast<int>((kDirectTileColumns - level.columns->taps) / scale));
+            level.tiles_per_row = (dst_image.width + level.tile_width - 1) / level.tile_width;
+        } else {
+            level.tile_width = 0;
+            level.tiles_per_row = (src_image.width + kDirectTileColumns - 1) / kDirectTileColumns;
+            level.vertical.resize(static_cast<size_t>(dst_image.height) * src_image.width * channels);
+            row_tasks.push_back({ l, row_count });
+            row_count += dst_image.height;
+        }
+        tile_tasks.push_back({ l, tile_count });
+        tile_count += dst_image.height * level.tiles_per_row;
+    }
+    // Range of a task of a loop
+    auto taskRange = [](const std::vector<TaskRange>& ranges, int task) {
+        size_t r = ranges.size() - 1;
+        while (ranges[r].first_task > task) {
+            r--;
+        }
+        return ranges[r];
+    };
+    // Sum of the decoded source rows of the vertical taps of destination row y, source columns [first_column, last_column)
+    auto verticalPass = [&](const AxisWeights& rows, int y, int first_column, int last_column, float* decoded, float* acc) {
+        const int count = last_column - first_column;
+        bool accumulate = false;
+        for (int k = 0; k < rows.taps; k++) {
+            const float weight = rows.weights[static_cast<size_t>(y) * rows.taps + k];
+            // Windows narrower than the widest one end in zeros
+            if (weight == 0.0f) {
+                continue;
+            }
+            const unsigned char* src_row = src_image.row(rows.first[y] + k) + first_column * pixel_bytes;
+            codec.decode[0](&src_row, count, decoded);
+            mKernels->weight_row(decoded, weight, count * channels, accumulate, acc);
+            accumulate = true;
+        }
+    };
+
+    mThreadPool.parallelFor(tile_count, [&](int task) {
+        const TaskRange range = taskRange(tile_tasks, task);
+        DirectLevel& level = levels[range.level];
+        const ImageView& dst_image = dst_images[range.level];
+        const int y = (task - range.first_task) / level.tiles_per_row;
+        const int tile = (task - range.first_task) % level.tiles_per_row;
+        if (level.tile_width == 0) {
+            const int first_column = tile * kDirectTileColumns;
+            const int last_column = std::min(first_column + kDirectTileColumns, src_image.width);
+            float* decoded = static_cast<float*>(scratchMemory(sizeof(float) * channels * (last_column - first_column)));
+            verticalPass(*level.rows, y, first_column, last_column, decoded,
+                         &level.vertical[(static_cast<size_t>(y) * src_image.width + first_column) * channels]);
+            return;
+        }
+        const int first_x = tile * level.tile_width;
+        const int last_x = std::min(first_x + level.tile_width, dst_image.width);
+        const int first_column = level.columns->first[first_x];
+        const int last_column = level.columns->first[last_x - 1] + level.columns->taps;
+        const size_t span = static_cast<size_t>(last_column - first_column) * channels;
+        float* decoded = static_cast<float*>(scratchMemory(sizeof(float) * (2 * span + static_cast<size_t>(last_x - first_x) * channels)));
+        float* acc = decoded + span;
+        float* filtered = acc + span;
+        verticalPass(*level.rows, y, first_column, last_column, decoded, acc);
+        mKernels->resample_row[channels - 1](acc, first_column, &level.columns->first[first_x],
+                                             &level.columns->weights[static_cast<size_t>(first_x) * level.columns->taps],
+                                             level.columns->taps, last_x - first_x, filtered);
+        codec.encode_nearest(filtered, last_x - first_x, dst_image.row(y) + first_x * pixel_bytes);
+        layout.store(range.level, dst_image, first_x, last_x, y, y + 1);
+    });
+
+    // Horizontal pass of the levels that kept their vertical one
+    mThreadPool.parallelFor(row_count, [&](int task) {
+        const TaskRange range = taskRange(row_tasks, task);
+        const DirectLevel& level = levels[range.level];
+        const ImageView& dst_image = dst_images[range.level];
+        const int y = task - range.first_task;
+        float* filtered = static_cast<float*>(scratchMemory(sizeof(float) * channels * dst_image.width));
+        mKernels->resample_row[channels - 1](&level.vertical[static_cast<size_t>(y) * src_image.width * channels], 0,
+                                             level.columns->first.data(), level.columns->weights.data(),
+                                             level.columns->taps, dst_image.width, filtered);
+        codec.encode_nearest(filtered, dst_image.width, dst_image.row(y));
+        layout.store(range.level, dst_image, 0, dst_image.width, y, y + 1);
+    });
+}
+
+// Weights of an axis of src_size pixels resampled to dst_size pixels, computed the first time they are needed
+const AxisWeights& CPUMipMapGenerator::cachedAxisWeights(DirectFilter filter, int src_size, int dst_size) {
+    const std::array<int, 3> key{ static_cast<int>(filter), src_size, dst_size };
+    auto weights = mAxisWeights.find(key);
+    if (weights == mAxisWeights.end()) {
+        weights = mAxisWeights.emplace(key, axisWeights(filter, src_size, dst_size)).first;
+    }
+    return weights->second;
+}
+
+// HDR images, and sRGB, premultiplied alpha and normal maps (8 bit images only) decode the pixels to
+// floats before filtering them. 16 bit images have fixed point kernels of their own
+bool CPUMipMapGenerator::filtersAsFloat(const ImageView& image) const {
+    switch (image.format) {
+    case PixelFormat::UNorm8:
+        return mOptions.srgb || mOptions.premultiplied_alpha || mOptions.normal_map != NormalMap::None;
+    case PixelFormat::UNorm16:
+        return false;
+    default:
+        return true;
+    }
+}
+
+// Alpha test reference as a byte, in [1, 255]
+int CPUMipMapGenerator::alphaReference() const {
+    return std::min(255, std::max(1, static_cast<int>(std::ceil(mOptions.alpha_reference * 255.0f))));
+}
+
+// Number of pixels of image with each alpha value.
+// Its suffix sums are the alpha test coverage of every reference value
+std::array<unsigned long long, 256> CPUMipMapGenerator::alphaHistogram(const ImageView& image) {
+    // One histogram per band, merged at the end
+    const int bands = bandCount(image.height, image.width, mThreadPool.size());
+    const int rows_per_band = (image.height + bands - 1) / bands;
+    std::vector<AlphaHistogram> histograms(bands, AlphaHistogram{});
+    mThreadPool.parallelFor(bands, [&](int band) {
+        const int first_row = band * rows_per_band;
+        const int last_row = std::min(image.height, first_row + rows_per_band);
+        addAlphaHistogram(image, first_row, last_row, histograms[band]);
+    });
+    std::array<unsigned long long, 256> total{};
+    for (const AlphaHistogram& histogram : histograms) {
+        for (int a = 0; a < 256; a++) {
+            total[a] += histogram[a];
+        }
+    }
+    return total;
+}
+
+// Scales the alpha of image so that about target_coverage (fraction) of its pixels pass the alpha test.
+// Scaling alpha by reference / threshold makes exactly the pixels with alpha >= threshold pass it, so
+// a single histogram is enough: binary search the threshold whose coverage is the closest to the target,
+// then remap alpha with a 256 entry table (no passes over the image to try scales)
+void CPUMipMapGenerator::scaleAlphaToCoverage(const ImageView& image, double target_coverage) {
+    const std::array<unsigned long long, 256> histogram = alphaHistogram(image);
+    const double target = target_coverage * image.width * image.height;
+    // above[t] = pixels with alpha >= t, non increasing
+    unsigned long long above[257];
+    above[256] = 0;
+    for (int a = 255; a >= 0; a--) {
+        above[a] = above[a + 1] + histogram[a];
+    }
+    // First threshold in [1, 255] that does not cover more than the target
+    int low = 1;
+    int high = 255;
+    while (low < high) {
+        const int middle = (low + high) / 2;
+        if (static_cast<double>(above[middle]) <= target) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    int threshold = low;
+    if (threshold > 1 && std::abs(above[threshold - 1] - target) < std::abs(above[threshold] - target)) {
+        threshold--;
+    }
+    const int reference = alphaReference();
+    if (threshold == reference) {
+        return;
+    }
+    // alpha * reference / threshold, truncated: >= reference exactly when alpha >= threshold
+    unsigned char scaled[256];
+    for (int a = 0; a < 256; a++) {
+        scaled[a] = static_cast<unsigned char>(std::min(255, a * reference / threshold));
+    }
+    const int bands = bandCount(image.height, image.width, mThreadPool.size());
+    const int rows_per_band = (image.height + bands - 1) / bands;
+    mThreadPool.parallelFor(bands, [&](int band) {
+        const int first_row = band * rows_per_band;
+        const int last_row = std::min(image.height, first_row + rows_per_band);
+        const int channels = image.channels;
+        for (int y = first_row; y < last_row; y++) {
+            unsigned char* alpha = image.row(y) + channels - 1;
+            for (int x = 0; x < image.width; x++) {
+                alpha[channels * x] = scaled[alpha[channels * x]];
+            }
+        }
+    });
+}
+
+void CPUMipMapGenerator::transformColors(const ImageView& image, const LayoutLevels& layout) {
+    if (!mHasColorOps) {
+        return;
+    }
+    checkLevel(image, image);
+    // The operations see the color of the pixels, never premultiplied by alpha
+    CPUMipMapOptions straight_alpha = mOptions;
+    straight_alpha.premultiplied_alpha = false;
+    const RowCodec codec = mKernels->row_codec(straight_alpha, image.format, image.channels);
+    const int channels = codec.channels;
+    const ColorTransform color = pixelTransform(image, channels);
+    const int bands = bandCount(image.height, image.width, mThreadPool.size());
+    const int rows_per_band = (image.height + bands - 1) / bands;
+    mThreadPool.parallelFor(bands, [&](int band) {
+        const int first_row = band * rows_per_band;
+        const int last_row = std::min(image.height, first_row + rows_per_band);
+        float* values = static_cast<float*>(scratchMemory(sizeof(float) * channels * image.width));
+        for (int y = first_row; y < last_row; y++) {
+            const unsigned char* row = image.row(y);
+            codec.decode[0](&row, image.width, values);
+            mKernels->color_row[channels - 1](color, image.width, values);
+            codec.encode_nearest(values, image.width, image.row(y));
+            layout.store(0, image, 0, image.width, y, y + 1);
+        }
+    });
+}
+
+// Stores mip_maps[first_level .. num_levels) in layout, each level in bands of rows on the thread pool
+void CPUMipMapGenerator::storeLevels(const ImageView* mip_maps, int first_level, int num_levels, const LayoutLevels& layout) {
+    for (int l = first_level; l < num_levels; l++) {
+        if (!layout.stores(l)) {
+            continue;
+        }
+        const ImageView& level = mip_maps[l];
+        const int bands = bandCount(level.height, level.width, mThreadPool.size());
+        // Whole 4x4 squares (see storeRegion) in every band
+        const int rows_per_band = ((level.height + bands - 1) / bands + 3) & ~3;
+        mThreadPool.parallelFor((level.height + rows_per_band - 1) / rows_per_band, [&](int band) {
+            const int first_row = band * rows_per_band;
+            layout.store(l, level, 0, level.width, first_row, std::min(level.height, first_row + rows_per_band));
+        });
+    }
+}
+
+// Throws if dst_image can not be filtered from src_image with the options of the generator
+void CPUMipMapGenerator::checkLevel(const ImageView& src_image, const ImageView& dst_image) const {
+    // Pixels are R, RG, RGB or RGBA (the layout of the GPU Pixel struct when it has 4 channels of 8 bits)
+    const int channels = src_image.channels;
+    if (channels < 1 || channels > 4) {
+        throw std::runtime_error("CPUMipMapGenerator only supports images with 1 to 4 channels!");
+    }
+    if (dst_image.channels != channels) {
+        throw std::runtime_error("Destination image must have the channels of the source image!");
+    }
+    if (src_image.format == PixelFormat::UNorm8 && mOptions.normal_map != NormalMap::None) {
+        const int normal_channels = mOptions.normal_map == NormalMap::RG ? 2 : 3;
+        if (channels < normal_channels) {
+            throw std::runtime_error("Normal map does not have the channels of its layout!");
+        }
+        // The length goes to B (RG) or A (RGB)
+        if (mOptions.normal_length && channels == normal_channels) {
+            throw std::runtime_error("Normal map does not have a channel for the normal length!");
+        }
+    }
+    if (mHasColorOps && src_image.format == PixelFormat::UNorm8 && mOptions.normal_map != NormalMap::None) {
+        throw std::runtime_error("Color operations do not apply to normal maps!");
+    }
+    if (src_image.format != dst_image.format) {
+        throw std::runtime_error("Destination image must have the pixel format of the source image!");
+    }
+}
+
+// How many of dst_images, up to max_levels, can be generated from a single read of src_image
+int CPUMipMapGenerator::fusableLevels(const ImageView& src_image, const ImageView* dst_images, int max_levels) const {
+    checkLevel(src_image, dst_images[0]);
+    const int channels = src_image.channels;
+    if (!isNextLevel(src_image, dst_images[0])) {
+        throw std::runtime_error("Destination image must be the next level of the source image!");
+    }
+    // The first level can use any of the four filters (the tile reads one extra column/row of the src
+    // texture when it is odd), but the following ones only depend on their own tile when they come
+    // from a level with both dimensions even, i. e. a 2x2 box filter.
+    // A post filter reads the pixels around the region of the level above: it must be complete
+    int levels = 1;
+    while (levels < max_levels && mOptions.post_filter == PostFilter::None) {
+        const ImageView& last = dst_images[levels - 1];
+        if ((last.width % 2) != 0 || (last.height % 2) != 0 || dst_images[levels].channels != channels ||
+            dst_images[levels].format != src_image.format || !isNextLevel(last, dst_images[levels])) {
+            break;
+        }
+        ++levels;
+    }
+    return levels;
+}
+
+// The planar tiles only have the 2x2 box of 8 bit pixels. The levels after the first one of a tile come from
+// even levels of the same format: when the first one is a box, all of them are
+bool CPUMipMapGenerator::reducesPlanar(const ImageView& src_image) const {
+    return mOptions.planar_tiles && src_image.format == PixelFormat::UNorm8 && src_image.channels > 1 &&
+           !filtersAsFloat(src_image) && mOptions.post_filter == PostFilter::None &&
+           (src_image.width % 2) == 0 && (src_image.height % 2) == 0;
+}
+
+// Filter of the level after src_image, for the mode of the generator, the channels and format of the image
+// and its dimension case
+LevelKernel CPUMipMapGenerator::levelKernel(const ImageView& src_image) const {
+    const int columns = tapCount(src_image.width);
+    const int rows = tapCount(src_image.height);
+    LevelKernel kernel{};
+    kernel.codec = mKernels->row_codec(mOptions, src_image.format, src_image.channels);
+    // The fixed point filters work on the pixels, the float ones on the decoded values
+    const RegionFilters& filters = mKernels->region_filters(src_image.channels, columns, rows);
+    const RegionFilters& float_filters = mKernels->region_filters(kernel.codec.channels, columns, rows);
+    const bool as_float = filtersAsFloat(src_image);
+    if (src_image.format == PixelFormat::UNorm8 && !as_float && columns == 2 && rows == 2) {
+        // The box filter, whatever the filter option
+        kernel.filter_region = filters.fixed;
+    } else if (mOptions.filter != MipFilter::Bilinear) {
+        kernel.weights = &filterKernel(mOptions.filter, columns, rows);
+        kernel.filter_region = float_filters.neighbourhood;
+    } else if (as_float) {
+        kernel.filter_region = float_filters.separable;
+    } else if (src_image.format == PixelFormat::UNorm16) {
+        kernel.filter_region = filters.fixed16;
+    } else {
+        kernel.filter_region = filters.fixed;
+    }
+    if (mOptions.post_filter != PostFilter::None) {
+        kernel.post_filter_row = mKernels->post_filter_row[kernel.codec.channels - 1];
+        kernel.post_weights = &mPostFilterWeights;
+    }
+    return kernel;
+}
+
+// The color operations for the floats of the pixels of image: [0, 255] for 8 bit ones (linear if sRGB),
+// [0, 65535] for 16 bit ones and [0, 1] for the float ones
+ColorTransform CPUMipMapGenerator::pixelTransform(const ImageView& image, int channels) const {
+    const float max_value = image.format == PixelFormat::UNorm8 ? 255.0f : (image.format == PixelFormat::UNorm16 ? 65535.0f : 1.0f);
+    return pixelColorTransform(mColorTransform, channels, max_value);
+}
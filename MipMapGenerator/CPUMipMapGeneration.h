@@ -0,0 +1,161 @@
+#pragma once
+
+#include <array>
+#include <map>
+#include <vector>
+
+#include "ColorOps.h"
+#include "ImageData.h"
+#include "ImageView.h"
+#include "MipFilters.h"
+#include "TextureLayout.h"
+#include "ThreadPool.h"
+
+// Layout of the tangent space normals of a normal map
+enum class NormalMap : int {
+    // Not a normal map
+    None = 0,
+    // x, y and z in R, G and B
+    RGB,
+    // x and y in R and G, z is rebuilt from them
+    RG
+};
+
+// Filters of a level and the kernels of an instruction set, see CPUMipMapKernels.h
+struct LevelKernel;
+struct MipKernels;
+
+// Settings of the CPU generator
+struct CPUMipMapOptions {
+    // Bilinear are the GenerateMip.hlsl coefficients, the rest are the filter_option of MipFilters.hlsl
+    MipFilter filter{ MipFilter::Bilinear };
+    // The images are sRGB: filter in linear space (alpha is always linear).
+    // Not cheap: every source channel is looked up in the 256 entry table (gathered by AVX2 and AVX-512) and every
+    // one written in the encode table. Measured with a single thread (num_threads 1) only: ~7x the time of the
+    // 8 bit box, whose adds keep up with the reads of the source while no table lookup does. With the default
+    // thread pool the box runs into the memory bandwidth first, so expect less than 7x there, but it has not been
+    // measured. Decoding to fixed point for the integer kernels instead of floats measured the same
+    bool srgb{ false };
+    // Filter the color premultiplied by alpha (and divide it again when writing the level), so
+    // transparent pixels do not bleed into their neighbours (i. e. foliage or UI textures)
+    bool premultiplied_alpha{ false };
+    // Filter the texture as normals (averaged and renormalized). Ignores srgb and premultiplied_alpha
+    NormalMap normal_map{ NormalMap::None };
+    // Write the length of the averaged normal, before renormalizing, into B (RG) or A (RGB).
+    // The shorter the normal the bumpier its footprint, i. e. to derive roughness or variance (Toksvig)
+    bool normal_length{ false };
+    // Alpha tested textures (i. e. foliage): scale the alpha of every level generated by generatePyramid so
+    // the fraction of pixels with alpha >= alpha_reference is the same than in level 0
+    bool preserve_alpha_coverage{ false };
+    // Alpha test reference value, in [0, 1]
+    float alpha_reference{ 0.5f };
+    // Lanczos or Kaiser: generatePyramid resamples every level directly from level 0 with this windowed sinc
+    // (3 lobes), instead of reducing each one from the previous. Sharper, and the errors of the 2x reductions
+    // do not pile up through the chain. Any level sizes work, and all the levels are computed at once
+    DirectFilter direct_filter{ DirectFilter::None };
+    // Blur or sharpen (i. e. to counter the softness of the reductions) every level generated, in the same
+    // pass that reduces it. Each level is reduced from the filtered one above. Not available with direct_filter
+    PostFilter post_filter{ PostFilter::None };
+    // k of the Filters.hlsl kernels. 0 uses the one of its CSMain: 1 for blur and 2 for sharpen
+    float post_filter_strength{ 0.0f };
+    // Desaturate, tint and swizzle the colors (not premultiplied), in this order, in a single transform whatever
+    // their number. generatePyramid applies them to level 0, and every level is reduced from the transformed
+    // one: each level gets them once. Not available for normal maps
+    std::vector<ColorOp> color_ops;
+    // Reduce the tiles with each channel in a plane of its own, like the gs_R, gs_G, gs_B and gs_A arrays of
+    // GenerateMips_CS.hlsl: the pixels are split once per tile and put back together as each level is stored.
+    // Only for the 2x2 box of 8 bit images with 2 to 4 channels (no float modes nor post filter), the other
+    // levels keep the interleaved kernels. Same results either way.
+    // Off by default: the interleaved box already splits the pixel pairs with a shuffle per vector, and the
+    // extra passes that split and rebuild the pixels made it 2x slower for RG and RGBA on x86 (about as fast
+    // for RGB with AVX2, whose interleaved box has no SIMD loop). Kept to measure other CPUs (NEON loads planes)
+    bool planar_tiles{ false };
+    // generatePyramid finishes all the levels of a cache sized tile before moving on to the next one, 6 levels
+    // instead of the 4 of the fused passes. Off by default: it only saves reading the last level of each pass
+    // again (1/256 of its source), and it measured slower on one thread (~65 ms against ~55 ms for an 8K RGBA
+    // chain with a 2 MB L2 and a 105 MB L3). Kept to measure chains whose passes do not fit in the last level cache
+    bool pyramid_tiles{ false };
+    // 0 uses one thread per hardware thread
+    unsigned int num_threads{ 0 };
+};
+
+// CPU counterpart of GPUMipMapGenerator.
+// It implements the same weighted filters as GenerateMip.hlsl (computePixelEvenEven,
+// computePixelEvenOdd, computePixelOddEven and computePixelOddOdd), vectorized with
+// SSE2, AVX2, AVX-512 or NEON (the best the CPU has, picked at runtime), so mips can be generated on
+// machines without a D3D11 capable device. The filters of MipFilters.hlsl, gamma correct (sRGB), premultiplied
+// alpha and normal map filtering are available too (see CPUMipMapOptions), the blur and sharpen
+// kernels of Filters.hlsl can be applied to each level as it is written and the color operations of
+// Desaturate.hlsl to the chain.
+// 16 bit, half and single float (HDR) images are supported too. sRGB, premultiplied alpha and normal maps only
+// apply to 8 bit ones, the color_ops to every format.
+// Images keep their channels: R (masks, roughness), RG (two channel normal maps), RGB and RGBA pixels
+// have kernels of their own, so single channel textures do not pay for four.
+// Levels are ImageViews of any pitch: rectangles of an atlas, tiles of a larger buffer or flipped images
+// are filtered in place.
+// The rows of each level are split in bands that run in parallel on a thread pool.
+// Like GenerateMips_CS.hlsl, up to four levels can be written from a single read of the source, and
+// generatePyramid chains those passes down the whole chain (or finishes cache sized tiles of it, see pyramid_tiles).
+// With a direct filter (Lanczos or Kaiser) it resamples every level from level 0 instead, all levels at once,
+// with the same resampler that resizes images to any size.
+class CPUMipMapGenerator {
+private:
+    CPUMipMapOptions mOptions;
+    ThreadPool mThreadPool;
+    const MipKernels* mKernels;
+    // Weights of the post_filter of the options
+    FilterKernel mPostFilterWeights;
+    // color_ops of the options, in [0, 1]
+    ColorTransform mColorTransform;
+    bool mHasColorOps;
+    // Weights of the resampler by filter, source and destination size
+    std::map<std::array<int, 3>, AxisWeights> mAxisWeights;
+    // Views of the images of generatePyramid, kept between calls so batches do not allocate them again
+    std::vector<ImageView> mPyramidViews;
+    // Helper private methods
+    int reduceLevels(const ImageView& src_image, const ImageView* dst_images, int max_levels, const LayoutLevels& layout);
+    void buildPyramid(const ImageView* mip_maps, int num_levels, const LayoutLevels& layout);
+    void resample(const ImageView& src_image, const ImageView* dst_images, int count, DirectFilter filter,
+                  const LayoutLevels& layout);
+    const AxisWeights& cachedAxisWeights(DirectFilter filter, int src_size, int dst_size);
+    bool filtersAsFloat(const ImageView& image) const;
+    int alphaReference() const;
+    std::array<unsigned long long, 256> alphaHistogram(const ImageView& image);
+    void scaleAlphaToCoverage(const ImageView& image, double target_coverage);
+    void storeLevels(const ImageView* mip_maps, int first_level, int num_levels, const LayoutLevels& layout);
+    void checkLevel(const ImageView& src_image, const ImageView& dst_image) const;
+    int fusableLevels(const ImageView& src_image, const ImageView* dst_images, int max_levels) const;
+    bool reducesPlanar(const ImageView& src_image) const;
+    LevelKernel levelKernel(const ImageView& src_image) const;
+    ColorTransform pixelTransform(const ImageView& image, int channels) const;
+
+public:
+    explicit CPUMipMapGenerator(const CPUMipMapOptions& options = CPUMipMapOptions());
+    // Instruction set of the kernels in use, i. e. "avx2"
+    const char* kernelsName() const;
+    // Applies the color_ops of the options to image, in place. Its rows are stored in layout too, as its level 0
+    void transformColors(const ImageView& image, const LayoutLevels& layout = LayoutLevels());
+    // Fills dst_image (already allocated, half the size of src_image) with the next mip level.
+    // No color_ops: src_image is a level of a chain that already has them (see transformColors)
+    bool generateMip(const ImageView& src_image, const ImageView& dst_image);
+    // Fills the next levels of src_image, dst_images[0], dst_images[1], ... (already allocated) reading
+    // the source only once. Returns how many were written, between 1 and min(max_levels, 4): levels
+    // after an odd sized one need a full pass of their own
+    int generateMips(const ImageView& src_image, const ImageView* dst_images, int max_levels);
+    // Fills dst_image (already allocated, of any size) with src_image resampled with the direct_filter of the
+    // options, Lanczos if they have none. Both axes are filtered separately, with SIMD passes split in rows on
+    // the thread pool, and the weights of every size are computed once: i. e. to scale textures to a power of
+    // two before generating their mips, or for thumbnails
+    bool resize(const ImageView& src_image, const ImageView& dst_image);
+    // Fills mip_maps[1 .. num_levels) (already allocated) from mip_maps[0], transformed first by transformColors.
+    // Same results as calling transformColors and then generateMip level by level, unless the options have a
+    // direct_filter.
+    // The levels of layout_levels are written too, in its layout (i. e. MipChain::layoutLevels), all but level 0
+    // unless it is transformed: each tile is stored right after it is filtered, while it is still in cache,
+    // instead of in a pass of its own. With preserve_alpha_coverage the levels are stored once their alpha
+    // is scaled, in a parallel pass
+    void generatePyramid(const ImageView* mip_maps, int num_levels, const LayoutLevels& layout_levels = LayoutLevels());
+    // Same for the levels of images, i. e. the ones of a MipChain
+    void generatePyramid(ImageData* mip_maps, int num_levels, const LayoutLevels& layout_levels = LayoutLevels());
+    ~CPUMipMapGenerator();
+};
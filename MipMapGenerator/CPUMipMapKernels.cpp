@@ -0,0 +1,197 @@
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MIPGEN_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+#if defined(__arm__) && defined(__linux__)
+#include <sys/auxv.h>
+#endif
+
+#include "CPUMipMapKernels.h"
+#include "MipChain.h"
+
+namespace {
+
+// Instruction sets of the kernels the CPU has (and the OS saves the registers of)
+struct CpuFeatures {
+    bool sse2{ false };
+    bool avx2{ false };
+    bool avx512{ false };
+    bool neon{ false };
+};
+
+#if defined(MIPGEN_X86)
+// eax, ebx, ecx and edx of the leaf
+void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int regs[4]) {
+#if defined(_MSC_VER)
+    int values[4];
+    __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (int i = 0; i < 4; i++) {
+        regs[i] = static_cast<unsigned int>(values[i]);
+    }
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Registers saved by the OS on context switches (XCR0). Without them the AVX instructions fault
+unsigned long long enabledRegisters() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+#endif
+
+CpuFeatures cpuFeatures() {
+    CpuFeatures features;
+#if defined(MIPGEN_X86)
+    unsigned int regs[4];
+    cpuid(0, 0, regs);
+    const unsigned int max_leaf = regs[0];
+    cpuid(1, 0, regs);
+    features.sse2 = (regs[3] & (1u << 26)) != 0;
+    const bool osxsave = (regs[2] & (1u << 27)) != 0;
+    const bool avx = (regs[2] & (1u << 28)) != 0;
+    const bool f16c = (regs[2] & (1u << 29)) != 0;
+    const unsigned long long registers = osxsave ? enabledRegisters() : 0;
+    // XMM and YMM state
+    if (max_leaf >= 7 && avx && f16c && (registers & 0x6) == 0x6) {
+        cpuid(7, 0, regs);
+        features.avx2 = (regs[1] & (1u << 5)) != 0;
+        // AVX-512 F and BW, plus the opmask and ZMM state
+        const bool avx512f = (regs[1] & (1u << 16)) != 0;
+        const bool avx512bw = (regs[1] & (1u << 30)) != 0;
+        features.avx512 = features.avx2 && avx512f && avx512bw && (registers & 0xE6) == 0xE6;
+    }
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    // Advanced SIMD is part of ARMv8-A
+    features.neon = true;
+#elif defined(__arm__) && defined(__linux__)
+    features.neon = (getauxval(AT_HWCAP) & HWCAP_ARM_NEON) != 0;
+#endif
+    return features;
+}
+
+// Value of the MIPGEN_ISA environment variable, empty when it is not set
+std::string isaOverride() {
+    std::string isa;
+#if defined(_MSC_VER)
+    char* value = nullptr;
+    size_t length = 0;
+    if (_dupenv_s(&value, &length, "MIPGEN_ISA") == 0 && value != nullptr) {
+        isa = value;
+        std::free(value);
+    }
+#else
+    const char* value = std::getenv("MIPGEN_ISA");
+    if (value != nullptr) {
+        isa = value;
+    }
+#endif
+    return isa;
+}
+
+const MipKernels& selectKernels() {
+    const CpuFeatures features = cpuFeatures();
+    struct Candidate {
+        const MipKernels* kernels;
+        bool supported;
+    };
+    // From the fastest to the slowest
+    const Candidate candidates[] = {
+        { avx512Kernels(), features.avx512 },
+        { avx2Kernels(), features.avx2 },
+        { sse2Kernels(), features.sse2 },
+        { neonKernels(), features.neon },
+        { scalarKernels(), true }
+    };
+    const std::string isa = isaOverride();
+    for (const Candidate& candidate : candidates) {
+        if (candidate.kernels != nullptr && candidate.supported && (isa.empty() || isa == candidate.kernels->name)) {
+            return *candidate.kernels;
+        }
+    }
+    throw std::runtime_error("The " + isa + " kernels are not available on this machine!\n");
+}
+
+} // namespace
+
+const MipKernels& mipKernels() {
+    static const MipKernels& kernels = selectKernels();
+    return kernels;
+}
+
+void* scratchMemory(size_t bytes, int buffer) {
+    thread_local std::vector<unsigned char> memory[2];
+    if (memory[buffer].size() < bytes) {
+        memory[buffer].resize(bytes);
+    }
+    return memory[buffer].data();
+}
+
+void postFilterRegion(const LevelKernel& kernel, const ImageView& src_image, const ImageView& dst_image,
+                      int first_column, int last_column, int first_row, int last_row) {
+    // Reduced pixels: the region and one more on every side within the level
+    const int reduced_first_column = std::max(first_column - 1, 0);
+    const int reduced_last_column = std::min(last_column + 1, dst_image.width);
+    const int reduced_first_row = std::max(first_row - 1, 0);
+    const int reduced_last_row = std::min(last_row + 1, dst_image.height);
+    const int channels = kernel.codec.channels;
+    const int pixels = last_column - first_column;
+    const int reduced_pixels = reduced_last_column - reduced_first_column;
+    const size_t pixel_bytes = dst_image.bytesPerPixel();
+    // Reduced rows padded like the ones of a MipChain, the floats after them stay aligned
+    const size_t row_bytes = (dst_image.width * pixel_bytes + MipChain::kAlignment - 1) / MipChain::kAlignment * MipChain::kAlignment;
+    // Float rows have a pixel more on each side, repeated from the edge of the level when there are no more
+    const size_t float_row = static_cast<size_t>(pixels + 2) * channels;
+    unsigned char* scratch = static_cast<unsigned char*>(scratchMemory(
+        (reduced_last_row - reduced_first_row) * row_bytes + sizeof(float) * (4 * float_row), 1));
+    float* decoded = reinterpret_cast<float*>(scratch + (reduced_last_row - reduced_first_row) * row_bytes);
+    float* filtered = decoded + 3 * float_row;
+
+    // The reduced rows are a level of their own: rows of the source and the level starting at reduced_first_row
+    // (the source rows of a level row y start at 2 * y), all the columns
+    const ImageView src_rows = src_image.subRect(0, 2 * reduced_first_row, src_image.width, src_image.height - 2 * reduced_first_row);
+    ImageView reduced = dst_image.subRect(0, reduced_first_row, dst_image.width, reduced_last_row - reduced_first_row);
+    reduced.pixels = scratch;
+    reduced.pitch = static_cast<ptrdiff_t>(row_bytes);
+    kernel.filter_region(kernel, src_rows, reduced, reduced_first_column, reduced_last_column, 0, reduced.height);
+
+    // Decoded rows, decoded[y % 3] holds row y
+    int decoded_rows[3] = { -1, -1, -1 };
+    auto decodedRow = [&](int y) {
+        float* row = decoded + (y % 3) * float_row;
+        if (decoded_rows[y % 3] != y) {
+            const unsigned char* pixels_row = scratch + (y - reduced_first_row) * row_bytes + reduced_first_column * pixel_bytes;
+            float* first = row + (reduced_first_column - (first_column - 1)) * channels;
+            kernel.codec.decode[0](&pixels_row, reduced_pixels, first);
+            if (first_column == 0) {
+                std::copy(row + channels, row + 2 * channels, row);
+            }
+            if (last_column == dst_image.width) {
+                std::copy(row + pixels * channels, row + (pixels + 1) * channels, row + (pixels + 1) * channels);
+            }
+            decoded_rows[y % 3] = y;
+        }
+        return row;
+    };
+    for (int y = first_row; y < last_row; y++) {
+        const float* rows[3] = {
+            decodedRow(std::max(y - 1, 0)), decodedRow(y), decodedRow(std::min(y + 1, dst_image.height - 1))
+        };
+        kernel.post_filter_row(rows, *kernel.post_weights, pixels, filtered);
+        kernel.codec.encode_nearest(filtered, pixels, dst_image.row(y) + first_column * pixel_bytes);
+    }
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "CPUMipMapGeneration.h"
+#include "ColorOps.h"
+#include "HalfFloat.h"
+#include "SrgbTables.h"
+
+// The kernels of CPUMipMapGenerator are built once per instruction set: each CPUMipMapKernels<ISA>.cpp
+// includes CPUMipMapKernels.inl with the ISA macros and compiler target of its own. mipKernels picks the
+// best set the CPU supports at startup, so a single binary runs everywhere and still uses AVX2 or AVX-512
+// where they are available.
+// Everything the kernels need from the standard library is included here, before any target is set
+
+// Alpha channel of pixels with the given number of channels (grey + alpha and RGBA), -1 when they have none
+constexpr int alphaChannel(int channels) {
+    return (channels == 2 || channels == 4) ? channels - 1 : -1;
+}
+
+// Conversions between the pixels and the floats filtered in the sRGB, premultiplied alpha and normal map modes,
+// by the MipFilters.hlsl filters and for HDR images. Both work on pixel counts
+struct RowCodec {
+    // Vertical filter of the decoded rows, decode[rows - 1] for each number of rows of the neighbourhood
+    void (*decode[3])(const unsigned char* const* rows, int pixels, float* acc);
+    void (*encode)(const float* src, int pixels, unsigned char* dst);
+    // Same as encode, rounding to the nearest value instead of truncating. The MipFilters.hlsl neighbourhoods and
+    // the wide filters of the levels resampled from level 0 sum their taps with a little error, truncating
+    // would darken flat areas
+    void (*encode_nearest)(const float* src, int pixels, unsigned char* dst);
+    // Floats per filtered pixel: the channels of the image, 4 (x, y, z and alpha) for normals
+    int channels;
+};
+
+struct LevelKernel;
+
+// Reduces the pixels [first_column, last_column) x [first_row, last_row) of dst_image, and the pixels around them,
+// to scratch memory, then writes them to dst_image through the post filter of kernel. The pixels around
+// are reduced again by the regions next to this one: no region reads what another one writes
+void postFilterRegion(const LevelKernel& kernel, const ImageView& src_image, const ImageView& dst_image,
+                      int first_column, int last_column, int first_row, int last_row);
+
+// Filter of a level, picked once per level by CPUMipMapGenerator::levelKernel. filter_region is instantiated
+// for the channels and the neighbourhood (dimension case) of the level, so the loops of its kernels do not
+// branch on them and the 2x2 / 3x3 footprints unroll with constant weights
+struct LevelKernel {
+    // Computes the pixels [first_column, last_column) x [first_row, last_row) of dst_image
+    void (*filter_region)(const LevelKernel& kernel, const ImageView& src_image, const ImageView& dst_image,
+                          int first_column, int last_column, int first_row, int last_row);
+    // Conversions of the float filters
+    RowCodec codec;
+    // Weights of the MipFilters.hlsl filters
+    const FilterKernel* weights;
+    // 3x3 filter of the codec floats applied to the reduced level (Filters.hlsl blur or sharpen), null without one
+    void (*post_filter_row)(const float* const* rows, const FilterKernel& weights, int pixels, float* dst);
+    const FilterKernel* post_weights;
+
+    void filter(const ImageView& src_image, const ImageView& dst_image, int first_column, int last_column, int first_row, int last_row) const {
+        if (post_filter_row != nullptr) {
+            postFilterRegion(*this, src_image, dst_image, first_column, last_column, first_row, last_row);
+        } else {
+            filter_region(*this, src_image, dst_image, first_column, last_column, first_row, last_row);
+        }
+    }
+};
+
+typedef void (*RegionFilter)(const LevelKernel& kernel, const ImageView& src_image, const ImageView& dst_image,
+                             int first_column, int last_column, int first_row, int last_row);
+
+// Every way to filter a level with the same channels and neighbourhood
+struct RegionFilters {
+    RegionFilter fixed;
+    RegionFilter fixed16;
+    RegionFilter separable;
+    RegionFilter neighbourhood;
+};
+
+
+// Entry points of the kernels built for one instruction set
+struct MipKernels {
+    // "scalar", "sse2", "avx2", "avx512" or "neon"
+    const char* name;
+    // Filters of a level by channels (1 to 4) and neighbourhood (1 to 3 columns and rows)
+    const RegionFilters& (*region_filters)(int channels, int columns, int rows);
+    // Conversions of the float filters for the options and the pixels of a level
+    RowCodec (*row_codec)(const CPUMipMapOptions& options, PixelFormat format, int channels);
+    // Vertical pass of the levels resampled from level 0: acc[i] = weight * src[i], or acc[i] += weight * src[i]
+    // when accumulate, for count floats
+    void (*weight_row)(const float* src, float weight, int count, bool accumulate, float* acc);
+    // Horizontal pass, resample_row[channels - 1]: count pixels of channels floats from src, whose first pixel
+    // is the source pixel src_offset, with the AxisWeights first and weights of the first destination pixel
+    void (*resample_row[4])(const float* src, int src_offset, const int* first, const float* weights, int taps,
+                            int count, float* dst);
+    // 3x3 post filter, post_filter_row[channels - 1]: pixels pixels of channels floats, rows[j] points to the
+    // pixel before the first one of row j of the neighbourhood. Alpha is copied from the center
+    void (*post_filter_row[4])(const float* const* rows, const FilterKernel& weights, int pixels, float* dst);
+    // Color operations, color_row[channels - 1]: the pixels of channels floats of values, in place
+    void (*color_row[4])(const ColorTransform& transform, int pixels, float* values);
+    // Planar working layout of the 8 bit box reductions (CPUMipMapOptions::planar_tiles).
+    // deinterleave[channels - 1] splits pixels pixels in channel planes, channel c at planes + c * plane_size,
+    // interleave[channels - 1] puts them back together
+    void (*deinterleave[4])(const unsigned char* src, int pixels, unsigned char* planes, size_t plane_size);
+    void (*interleave[4])(const unsigned char* planes, size_t plane_size, int pixels, unsigned char* dst);
+    // 2x2 box of a plane, dst_width bytes from the byte pairs of row0 and row1
+    void (*box_plane_row)(const unsigned char* row0, const unsigned char* row1, int dst_width, unsigned char* dst);
+};
+
+// Kernels of each instruction set, null when they are not built for the target platform
+const MipKernels* scalarKernels();
+const MipKernels* sse2Kernels();
+const MipKernels* avx2Kernels();
+const MipKernels* avx512Kernels();
+const MipKernels* neonKernels();
+
+// The fastest kernels the CPU supports, picked on the first call. The MIPGEN_ISA environment variable
+// (scalar, sse2, avx2, avx512 or neon) forces a set instead, i. e. to benchmark them against each other.
+// Throws if that set is not available on this machine
+const MipKernels& mipKernels();
+
+// Scratch memory of the calling thread, at least bytes long. It is allocated out of the kernels, so the
+// standard library code behind it is never built for a wider ISA than the CPU has.
+// The kernels use buffer 0, code that calls them while it holds scratch memory of its own uses buffer 1
+void* scratchMemory(size_t bytes, int buffer = 0);
@@ -0,0 +1,2064 @@
+// Kernels of CPUMipMapGenerator, included once per instruction set by the CPUMipMapKernels<ISA>.cpp files
+// after CPUMipMapKernels.h and the intrinsics they need. They define the macros of the ISA:
+//     MIPGEN_SSE2, MIPGEN_AVX2, MIPGEN_F16C, MIPGEN_AVX512 and MIPGEN_NEON
+// Each SIMD loop runs while there are enough pixels left, then the next narrower one (and finally the scalar
+// loop) does the rest, so every set writes the same bytes.
+// Everything is in an anonymous namespace: each ISA has its own copy and none of them is shared at link time
+
+// No fused multiply-adds, not even in the scalar loops of the ISAs that have them: they round differently
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace {
+
+// Scratch row of each thread with the vertically filtered source pixels (as floats or fixed point)
+template <typename T>
+T* scratchRow(size_t elements) {
+    return static_cast<T*>(scratchMemory(elements * sizeof(T)));
+}
+
+// Weight of each tap along one axis: {1}, {0.5, 0.5} or {0.25, 0.5, 0.25}.
+// The 2D coefficients of GenerateMip.hlsl are the product of the horizontal and the vertical ones
+// i. e. 0.5 * 0.5 = 0.25, 0.5 * 0.25 = 0.125 and 0.25 * 0.25 = 0.0625
+constexpr float tapWeight(int taps, int tap) {
+    return taps == 1 ? 1.0f : ((taps == 2 || tap == 1) ? 0.5f : 0.25f);
+}
+
+#if defined(MIPGEN_AVX512)
+// Puts the 64 bit halves of the 128 bit lanes back in order after splitting each lane: first halves, then second
+// ones. _mm256_permute4x64_epi64(v, 0xD8) for 512 bits
+inline __m512i orderHalves(__m512i v) {
+    return _mm512_permutexvar_epi64(_mm512_set_epi64(7, 5, 3, 1, 6, 4, 2, 0), v);
+}
+#endif
+
+// Splits consecutive pixels of PixelBytes bytes (1, 2 or 4 channels of the scratch rows) in the even and the
+// odd ones, i. e. the first and the second tap of the horizontal filters, keeping them in order.
+// RGB pixels straddle the lanes: they are not supported and use the scalar loops.
+// NEON vectors are typed: the split works on their bytes, the kernels reinterpret them
+template <int PixelBytes>
+struct PixelPairs {
+    static const bool supported = false;
+#if defined(MIPGEN_SSE2)
+    static void split(__m128i a, __m128i b, __m128i& even, __m128i& odd) {
+        even = a;
+        odd = b;
+    }
+#endif
+#if defined(MIPGEN_AVX2)
+    static void split(__m256i a, __m256i b, __m256i& even, __m256i& odd) {
+        even = a;
+        odd = b;
+    }
+#endif
+#if defined(MIPGEN_AVX512)
+    static void split(__m512i a, __m512i b, __m512i& even, __m512i& odd) {
+        even = a;
+        odd = b;
+    }
+#endif
+#if defined(MIPGEN_NEON)
+    static void split(uint8x16_t a, uint8x16_t b, uint8x16_t& even, uint8x16_t& odd) {
+        even = a;
+        odd = b;
+    }
+#endif
+};
+
+// The 256 and 512 bit versions split each 128 bit lane, then put the 64 bit halves back in order
+template <>
+struct PixelPairs<2> {
+    static const bool supported = true;
+#if defined(MIPGEN_SSE2)
+    static void split(__m128i a, __m128i b, __m128i& even, __m128i& odd) {
+        // Sign extended to 32 bits, so any 16 bit value survives the saturating pack
+        even = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+        odd = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+    }
+#endif
+#if defined(MIPGEN_AVX2)
+    static void split(__m256i a, __m256i b, __m256i& even, __m256i& odd) {
+        even = _mm256_packs_epi32(_mm256_srai_epi32(_mm256_slli_epi32(a, 16), 16), _mm256_srai_epi32(_mm256_slli_epi32(b, 16), 16));
+        odd = _mm256_packs_epi32(_mm256_srai_epi32(a, 16), _mm256_srai_epi32(b, 16));
+        even = _mm256_permute4x64_epi64(even, 0xD8);
+        odd = _mm256_permute4x64_epi64(odd, 0xD8);
+    }
+#endif
+#if defined(MIPGEN_AVX512)
+    static void split(__m512i a, __m512i b, __m512i& even, __m512i& odd) {
+        even = orderHalves(_mm512_packs_epi32(_mm512_srai_epi32(_mm512_slli_epi32(a, 16), 16), _mm512_srai_epi32(_mm512_slli_epi32(b, 16), 16)));
+        odd = orderHalves(_mm512_packs_epi32(_mm512_srai_epi32(a, 16), _mm512_srai_epi32(b, 16)));
+    }
+#endif
+#if defined(MIPGEN_NEON)
+    static void split(uint8x16_t a, uint8x16_t b, uint8x16_t& even, uint8x16_t& odd) {
+        const uint16x8x2_t pixels = vuzpq_u16(vreinterpretq_u16_u8(a), vreinterpretq_u16_u8(b));
+        even = vreinterpretq_u8_u16(pixels.val[0]);
+        odd = vreinterpretq_u8_u16(pixels.val[1]);
+    }
+#endif
+};
+
+template <>
+struct PixelPairs<4> {
+    static const bool supported = true;
+#if defined(MIPGEN_SSE2)
+    static void split(__m128i a, __m128i b, __m128i& even, __m128i& odd) {
+        even = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0)));
+        odd = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+#endif
+#if defined(MIPGEN_AVX2)
+    static void split(__m256i a, __m256i b, __m256i& even, __m256i& odd) {
+        even = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _MM_SHUFFLE(2, 0, 2, 0)));
+        odd = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _MM_SHUFFLE(3, 1, 3, 1)));
+        even = _mm256_permute4x64_epi64(even, 0xD8);
+        odd = _mm256_permute4x64_epi64(odd, 0xD8);
+    }
+#endif
+#if defined(MIPGEN_AVX512)
+    static void split(__m512i a, __m512i b, __m512i& even, __m512i& odd) {
+        even = orderHalves(_mm512_castps_si512(_mm512_shuffle_ps(_mm512_castsi512_ps(a), _mm512_castsi512_ps(b), _MM_SHUFFLE(2, 0, 2, 0))));
+        odd = orderHalves(_mm512_castps_si512(_mm512_shuffle_ps(_mm512_castsi512_ps(a), _mm512_castsi512_ps(b), _MM_SHUFFLE(3, 1, 3, 1))));
+    }
+#endif
+#if defined(MIPGEN_NEON)
+    static void split(uint8x16_t a, uint8x16_t b, uint8x16_t& even, uint8x16_t& odd) {
+        const uint32x4x2_t pixels = vuzpq_u32(vreinterpretq_u32_u8(a), vreinterpretq_u32_u8(b));
+        even = vreinterpretq_u8_u32(pixels.val[0]);
+        odd = vreinterpretq_u8_u32(pixels.val[1]);
+    }
+#endif
+};
+
+template <>
+struct PixelPairs<8> {
+    static const bool supported = true;
+#if defined(MIPGEN_SSE2)
+    static void split(__m128i a, __m128i b, __m128i& even, __m128i& odd) {
+        even = _mm_unpacklo_epi64(a, b);
+        odd = _mm_unpackhi_epi64(a, b);
+    }
+#endif
+#if defined(MIPGEN_AVX2)
+    static void split(__m256i a, __m256i b, __m256i& even, __m256i& odd) {
+        even = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(a, b), 0xD8);
+        odd = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(a, b), 0xD8);
+    }
+#endif
+#if defined(MIPGEN_AVX512)
+    static void split(__m512i a, __m512i b, __m512i& even, __m512i& odd) {
+        even = orderHalves(_mm512_unpacklo_epi64(a, b));
+        odd = orderHalves(_mm512_unpackhi_epi64(a, b));
+    }
+#endif
+#if defined(MIPGEN_NEON)
+    static void split(uint8x16_t a, uint8x16_t b, uint8x16_t& even, uint8x16_t& odd) {
+        even = vcombine_u8(vget_low_u8(a), vget_low_u8(b));
+        odd = vcombine_u8(vget_high_u8(a), vget_high_u8(b));
+    }
+#endif
+};
+
+template <>
+struct PixelPairs<16> {
+    static const bool supported = true;
+#if defined(MIPGEN_SSE2)
+    static void split(__m128i a, __m128i b, __m128i& even, __m128i& odd) {
+        even = a;
+        odd = b;
+    }
+#endif
+#if defined(MIPGEN_AVX2)
+    static void split(__m256i a, __m256i b, __m256i& even, __m256i& odd) {
+        even = _mm256_permute2x128_si256(a, b, 0x20);
+        odd = _mm256_permute2x128_si256(a, b, 0x31);
+    }
+#endif
+#if defined(MIPGEN_AVX512)
+    static void split(__m512i a, __m512i b, __m512i& even, __m512i& odd) {
+        even = _mm512_shuffle_i64x2(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        odd = _mm512_shuffle_i64x2(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    }
+#endif
+#if defined(MIPGEN_NEON)
+    static void split(uint8x16_t a, uint8x16_t b, uint8x16_t& even, uint8x16_t& odd) {
+        even = a;
+        odd = b;
+    }
+#endif
+};
+
+#if defined(MIPGEN_SSE2)
+inline __m128i loadPixels(const void* src) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+}
+#endif
+#if defined(MIPGEN_AVX2)
+inline __m256i loadPixels256(const void* src) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+}
+#endif
+#if defined(MIPGEN_AVX512)
+inline __m512i loadPixels512(const void* src) {
+    return _mm512_loadu_si512(src);
+}
+#endif
+#if defined(MIPGEN_NEON)
+inline uint8x16_t loadPixels(const void* src) {
+    return vld1q_u8(static_cast<const uint8_t*>(src));
+}
+#endif
+
+// Fixed point version of the GenerateMip.hlsl filters. Each axis weight is scaled by 4 ({2, 2}, {1, 2, 1} or {4}),
+// so the 2D weights are 16 times the float coefficients and the result is
+//     dst = (sum(weight_x * weight_y * src) >> 4) = floor(sum(coefficient * src))
+// i. e. truncated like writeToPixel, the same bytes the float kernels produce (their sums are exact).
+// The largest sum is 255 * 16, so everything fits in 16 bit lanes
+constexpr int fixedPointWeight(int taps, int tap) {
+    return static_cast<int>(tapWeight(taps, tap) * 4.0f);
+}
+
+// acc[i] = sum(4 * weight[j] * rows[j][i]) for i in [0, count)
+template <int Rows>
+void filterVerticalFixed(const unsigned char* const* rows, int count, uint16_t* acc) {
+    int i = 0;
+#if defined(MIPGEN_AVX512)
+    for (; i + 32 <= count; i += 32) {
+        __m512i sum = _mm512_setzero_si512();
+        for (int j = 0; j < Rows; j++) {
+            const __m512i words = _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[j] + i)));
+            sum = _mm512_add_epi16(sum, _mm512_mullo_epi16(words, _mm512_set1_epi16(static_cast<short>(fixedPointWeight(Rows, j)))));
+        }
+        _mm512_storeu_si512(acc + i, sum);
+    }
+#endif
+#if defined(MIPGEN_AVX2)
+    for (; i + 16 <= count; i += 16) {
+        __m256i sum = _mm256_setzero_si256();
+        for (int j = 0; j < Rows; j++) {
+            const __m256i words = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[j] + i)));
+            sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(words, _mm256_set1_epi16(static_cast<short>(fixedPointWeight(Rows, j)))));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + i), sum);
+    }
+#endif
+#if defined(MIPGEN_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= count; i += 8) {
+        __m128i sum = _mm_setzero_si128();
+        for (int j = 0; j < Rows; j++) {
+            const __m128i words = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(rows[j] + i)), zero);
+            sum = _mm_add_epi16(sum, _mm_mullo_epi16(words, _mm_set1_epi16(static_cast<short>(fixedPointWeight(Rows, j)))));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + i), sum);
+    }
+#endif
+#if defined(MIPGEN_NEON)
+    for (; i + 8 <= count; i += 8) {
+        uint16x8_t sum = vdupq_n_u16(0);
+        for (int j = 0; j < Rows; j++) {
+            sum = vmlaq_n_u16(sum, vmovl_u8(vld1_u8(rows[j] + i)), static_cast<uint16_t>(fixedPointWeight(Rows, j)));
+        }
+        vst1q_u16(acc + i, sum);
+    }
+#endif
+    for (; i < count; i++) {
+        int sum = 0;
+        for (int j = 0; j < Rows; j++) {
+            sum += fixedPointWeight(Rows, j) * rows[j][i];
+        }
+        acc[i] = static_cast<uint16_t>(sum);
+    }
+}
+
+// Filters the fixed point row horizontally and writes dst_width pixels of Channels channels.
+// acc needs one extra pixel of padding at the end, the SIMD loops may read (but do not use) it
+template <int Channels, int Columns>
+void filterHorizontalFixed(const uint16_t* acc, int dst_width, unsigned char* dst) {
+#if defined(MIPGEN_SSE2) || defined(MIPGEN_NEON)
+    typedef PixelPairs<2 * Channels> Pairs;
+#endif
+    const int w0 = fixedPointWeight(Columns, 0);
+    const int w1 = fixedPointWeight(Columns, 1);
+    const int w2 = fixedPointWeight(Columns, 2);
+    int x = 0;
+    // A single tap only happens when dst_width == 1, so the SIMD loops always have at least two taps
+#if defined(MIPGEN_AVX512)
+    // 32 channels per iteration
+    for (; Pairs::supported && x + 32 / Channels <= dst_width; x += 32 / Channels) {
+        const uint16_t* src = acc + 2 * Channels * x;
+        __m512i even, odd;
+        Pairs::split(loadPixels512(src), loadPixels512(src + 32), even, odd);
+        __m512i sum = _mm512_add_epi16(_mm512_mullo_epi16(even, _mm512_set1_epi16(static_cast<short>(w0))),
+                                       _mm512_mullo_epi16(odd, _mm512_set1_epi16(static_cast<short>(w1))));
+        if (Columns == 3) {
+            __m512i next, third;
+            Pairs::split(loadPixels512(src + Channels), loadPixels512(src + Channels + 32), next, third);
+            sum = _mm512_add_epi16(sum, _mm512_mullo_epi16(third, _mm512_set1_epi16(static_cast<short>(w2))));
+        }
+        // The filtered values fit in a byte, no need to saturate
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + Channels * x), _mm512_cvtepi16_epi8(_mm512_srli_epi16(sum, 4)));
+    }
+#endif
+#if defined(MIPGEN_AVX2)
+    // 16 channels per iteration
+    for (; Pairs::supported && x + 16 / Channels <= dst_width; x += 16 / Channels) {
+        const uint16_t* src = acc + 2 * Channels * x;
+        __m256i even, odd;
+        Pairs::split(loadPixels256(src), loadPixels256(src + 16), even, odd);
+        __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(even, _mm256_set1_epi16(static_cast<short>(w0))),
+                                       _mm256_mullo_epi16(odd, _mm256_set1_epi16(static_cast<short>(w1))));
+        if (Columns == 3) {
+            // The third taps are the odd pixels of the row one pixel further
+            __m256i next, third;
+            Pairs::split(loadPixels256(src + Channels), loadPixels256(src + Channels + 16), next, third);
+            sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(third, _mm256_set1_epi16(static_cast<short>(w2))));
+        }
+        const __m256i packed = _mm256_packus_epi16(_mm256_srli_epi16(sum, 4), _mm256_setzero_si256());
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + Channels * x),
+                         _mm_unpacklo_epi64(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1)));
+    }
+#endif
+#if defined(MIPGEN_SSE2)
+    // 8 channels per iteration
+    for (; Pairs::supported && x + 8 / Channels <= dst_width; x += 8 / Channels) {
+        const uint16_t* src = acc + 2 * Channels * x;
+        __m128i even, odd;
+        Pairs::split(loadPixels(src), loadPixels(src + 8), even, odd);
+        __m128i sum = _mm_add_epi16(_mm_mullo_epi16(even, _mm_set1_epi16(static_cast<short>(w0))),
+                                    _mm_mullo_epi16(odd, _mm_set1_epi16(static_cast<short>(w1))));
+        if (Columns == 3) {
+            __m128i next, third;
+            Pairs::split(loadPixels(src + Channels), loadPixels(src + Channels + 8), next, third);
+            sum = _mm_add_epi16(sum, _mm_mullo_epi16(third, _mm_set1_epi16(static_cast<short>(w2))));
+        }
+        sum = _mm_srli_epi16(sum, 4);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + Channels * x), _mm_packus_epi16(sum, sum));
+    }
+#endif
+#if defined(MIPGEN_NEON)
+    // 8 channels per iteration
+    for (; Pairs::supported && x + 8 / Channels <= dst_width; x += 8 / Channels) {
+        const uint16_t* src = acc + 2 * Channels * x;
+        uint8x16_t even, odd;
+        Pairs::split(loadPixels(src), loadPixels(src + 8), even, odd);
+        uint16x8_t sum = vmulq_n_u16(vreinterpretq_u16_u8(even), static_cast<uint16_t>(w0));
+        sum = vmlaq_n_u16(sum, vreinterpretq_u16_u8(odd), static_cast<uint16_t>(w1));
+        if (Columns == 3) {
+            uint8x16_t next, third;
+            Pairs::split(loadPixels(src + Channels), loadPixels(src + Channels + 8), next, third);
+            sum = vmlaq_n_u16(sum, vreinterpretq_u16_u8(third), static_cast<uint16_t>(w2));
+        }
+        vst1_u8(dst + Channels * x, vshrn_n_u16(sum, 4));
+    }
+#endif
+    for (; x < dst_width; x++) {
+        const uint16_t* src = acc + 2 * Channels * x;
+        for (int c = 0; c < Channels; c++) {
+            int sum = w0 * src[c];
+            if (Columns > 1) {
+                sum += w1 * src[Channels + c];
+            }
+            if (Columns > 2) {
+                sum += w2 * src[2 * Channels + c];
+            }
+            dst[Channels * x + c] = static_cast<unsigned char>(sum >> 4);
+        }
+    }
+}
+
+// 16 bit version of the fixed point filters (heightmaps, masks). The sums go up to 65535 * 16, so they
+// are widened to 32 bit lanes. The weights are 1, 2 or 4: the products are shifts by log2(weight)
+constexpr int fixedPointShift(int taps, int tap) {
+    return fixedPointWeight(taps, tap) >> 1;
+}
+
+template <int Rows>
+void filterVerticalFixed16(const uint16_t* const* rows, int count, uint32_t* acc) {
+    int i = 0;
+#if defined(MIPGEN_AVX512)
+    for (; i + 16 <= count; i += 16) {
+        __m512i sum = _mm512_setzero_si512();
+        for (int j = 0; j < Rows; j++) {
+            const __m512i values = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[j] + i)));
+            sum = _mm512_add_epi32(sum, _mm512_sll_epi32(values, _mm_cvtsi32_si128(fixedPointShift(Rows, j))));
+        }
+        _mm512_storeu_si512(acc + i, sum);
+    }
+#endif
+#if defined(MIPGEN_AVX2)
+    for (; i + 8 <= count; i += 8) {
+        __m256i sum = _mm256_setzero_si256();
+        for (int j = 0; j < Rows; j++) {
+            const __m256i values = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[j] + i)));
+            sum = _mm256_add_epi32(sum, _mm256_sll_epi32(values, _mm_cvtsi32_si128(fixedPointShift(Rows, j))));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + i), sum);
+    }
+#endif
+#if defined(MIPGEN_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        __m128i sum = _mm_setzero_si128();
+        for (int j = 0; j < Rows; j++) {
+            const __m128i values = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(rows[j] + i)), zero);
+            sum = _mm_add_epi32(sum, _mm_sll_epi32(values, _mm_cvtsi32_si128(fixedPointShift(Rows, j))));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + i), sum);
+    }
+#endif
+#if defined(MIPGEN_NEON)
+    for (; i + 4 <= count; i += 4) {
+        uint32x4_t sum = vdupq_n_u32(0);
+        for (int j = 0; j < Rows; j++) {
+            sum = vaddq_u32(sum, vshlq_u32(vmovl_u16(vld1_u16(rows[j] + i)), vdupq_n_s32(fixedPointShift(Rows, j))));
+        }
+        vst1q_u32(acc + i, sum);
+    }
+#endif
+    for (; i < count; i++) {
+        uint32_t sum = 0;
+        for (int j = 0; j < Rows; j++) {
+            sum += static_cast<uint32_t>(rows[j][i]) << fixedPointShift(Rows, j);
+        }
+        acc[i] = sum;
+    }
+}
+
+// acc needs one extra pixel of padding at the end, like filterHorizontalFixed
+template <int Channels, int Columns>
+void filterHorizontalFixed16(const uint32_t* acc, int dst_width, uint16_t* dst) {
+#if defined(MIPGEN_SSE2) || defined(MIPGEN_NEON)
+    typedef PixelPairs<4 * Channels> Pairs;
+#endif
+    const int s0 = fixedPointShift(Columns, 0);
+    const int s1 = fixedPointShift(Columns, 1);
+    const int s2 = fixedPointShift(Columns, 2);
+    int x = 0;
+#if defined(MIPGEN_AVX512)
+    // 16 channels per iteration
+    for (; Pairs::supported && x + 16 / Channels <= dst_width; x += 16 / Channels) {
+        const uint32_t* src = acc + 2 * Channels * x;
+        __m512i even, odd;
+        Pairs::split(loadPixels512(src), loadPixels512(src + 16), even, odd);
+        __m512i sum = _mm512_sll_epi32(even, _mm_cvtsi32_si128(s0));
+        if (Columns > 1) {
+            sum = _mm512_add_epi32(sum, _mm512_sll_epi32(odd, _mm_cvtsi32_si128(s1)));
+        }
+        if (Columns == 3) {
+            __m512i next, third;
+            Pairs::split(loadPixels512(src + Channels), loadPixels512(src + Channels + 16), next, third);
+            sum = _mm512_add_epi32(sum, _mm512_sll_epi32(third, _mm_cvtsi32_si128(s2)));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + Channels * x), _mm512_cvtepi32_epi16(_mm512_srli_epi32(sum, 4)));
+    }
+#endif
+#if defined(MIPGEN_AVX2)
+    // 8 channels per iteration
+    for (; Pairs::supported && x + 8 / Channels <= dst_width; x += 8 / Channels) {
+        const uint32_t* src = acc + 2 * Channels * x;
+        __m256i even, odd;
+        Pairs::split(loadPixels256(src), loadPixels256(src + 8), even, odd);
+        __m256i sum = _mm256_sll_epi32(even, _mm_cvtsi32_si128(s0));
+        if (Columns > 1) {
+            sum = _mm256_add_epi32(sum, _mm256_sll_epi32(odd, _mm_cvtsi32_si128(s1)));
+        }
+        if (Columns == 3) {
+            __m256i next, third;
+            Pairs::split(loadPixels256(src + Channels), loadPixels256(src + Channels + 8), next, third);
+            sum = _mm256_add_epi32(sum, _mm256_sll_epi32(third, _mm_cvtsi32_si128(s2)));
+        }
+        const __m256i packed = _mm256_packus_epi32(_mm256_srli_epi32(sum, 4), _mm256_setzero_si256());
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + Channels * x),
+                         _mm_unpacklo_epi64(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1)));
+    }
+#endif
+#if defined(MIPGEN_SSE2)
+    // 4 channels per iteration. SSE2 has no unsigned 32 bit pack: bias to signed and back
+    const __m128i bias32 = _mm_set1_epi32(32768);
+    const __m128i bias16 = _mm_set1_epi16(-32768);
+    for (; Pairs::supported && x + 4 / Channels <= dst_width; x += 4 / Channels) {
+        const uint32_t* src = acc + 2 * Channels * x;
+        __m128i even, odd;
+        Pairs::split(loadPixels(src), loadPixels(src + 4), even, odd);
+        __m128i sum = _mm_sll_epi32(even, _mm_cvtsi32_si128(s0));
+        if (Columns > 1) {
+            sum = _mm_add_epi32(sum, _mm_sll_epi32(odd, _mm_cvtsi32_si128(s1)));
+        }
+        if (Columns == 3) {
+            __m128i next, third;
+            Pairs::split(loadPixels(src + Channels), loadPixels(src + Channels + 4), next, third);
+            sum = _mm_add_epi32(sum, _mm_sll_epi32(third, _mm_cvtsi32_si128(s2)));
+        }
+        sum = _mm_sub_epi32(_mm_srli_epi32(sum, 4), bias32);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + Channels * x), _mm_add_epi16(_mm_packs_epi32(sum, sum), bias16));
+    }
+#endif
+#if defined(MIPGEN_NEON)
+    // 4 channels per iteration
+    for (; Pairs::supported && x + 4 / Channels <= dst_width; x += 4 / Channels) {
+        const uint32_t* src = acc + 2 * Channels * x;
+        uint8x16_t even, odd;
+        Pairs::split(loadPixels(src), loadPixels(src + 4), even, odd);
+        uint32x4_t sum = vshlq_u32(vreinterpretq_u32_u8(even), vdupq_n_s32(s0));
+        if (Columns > 1) {
+            sum = vaddq_u32(sum, vshlq_u32(vreinterpretq_u32_u8(odd), vdupq_n_s32(s1)));
+        }
+        if (Columns == 3) {
+            uint8x16_t next, third;
+            Pairs::split(loadPixels(src + Channels), loadPixels(src + Channels + 4), next, third);
+            sum = vaddq_u32(sum, vshlq_u32(vreinterpretq_u32_u8(third), vdupq_n_s32(s2)));
+        }
+        vst1_u16(dst + Channels * x, vshrn_n_u32(sum, 4));
+    }
+#endif
+    for (; x < dst_width; x++) {
+        const uint32_t* src = acc + 2 * Channels * x;
+        for (int c = 0; c < Channels; c++) {
+            uint32_t sum = src[c] << s0;
+            if (Columns > 1) {
+                sum += src[Channels + c] << s1;
+            }
+            if (Columns > 2) {
+                sum += src[2 * Channels + c] << s2;
+            }
+            dst[Channels * x + c] = static_cast<uint16_t>(sum >> 4);
+        }
+    }
+}
+
+// Filters the float rows of the neighbourhood with a 2D kernel and writes dst_width pixels:
+// dst[x] = sum(kernel.weights[j][i] * rows[j][2x + i])
+template <int Channels, int Columns, int Rows>
+void filterNeighbourhood(const float* const* rows, const FilterKernel& kernel, int dst_width, float* dst) {
+#if defined(MIPGEN_SSE2) || defined(MIPGEN_NEON)
+    typedef PixelPairs<4 * Channels> Pairs;
+#endif
+    int x = 0;
+#if defined(MIPGEN_AVX512)
+    __m512 weights512[3][3];
+    for (int j = 0; j < Rows; j++) {
+        for (int i = 0; i < Columns; i++) {
+            weights512[j][i] = _mm512_set1_ps(kernel.weights[j][i]);
+        }
+    }
+    // 16 channels per iteration
+    for (; Pairs::supported && x + 16 / Channels <= dst_width; x += 16 / Channels) {
+        __m512 sum = _mm512_setzero_ps();
+        for (int j = 0; j < Rows; j++) {
+            const float* src = rows[j] + 2 * Channels * x;
+            __m512i taps[3];
+            Pairs::split(loadPixels512(src), loadPixels512(src + 16), taps[0], taps[1]);
+            if (Columns == 3) {
+                __m512i next;
+                Pairs::split(loadPixels512(src + Channels), loadPixels512(src + Channels + 16), next, taps[2]);
+            }
+            for (int i = 0; i < Columns; i++) {
+                sum = _mm512_add_ps(sum, _mm512_mul_ps(weights512[j][i], _mm512_castsi512_ps(taps[i])));
+            }
+        }
+        _mm512_storeu_ps(dst + Channels * x, sum);
+    }
+#endif
+#if defined(MIPGEN_AVX2)
+    __m256 weights256[3][3];
+    for (int j = 0; j < Rows; j++) {
+        for (int i = 0; i < Columns; i++) {
+            weights256[j][i] = _mm256_set1_ps(kernel.weights[j][i]);
+        }
+    }
+    // 8 channels per iteration
+    for (; Pairs::supported && x + 8 / Channels <= dst_width; x += 8 / Channels) {
+        __m256 sum = _mm256_setzero_ps();
+        for (int j = 0; j < Rows; j++) {
+            const float* src = rows[j] + 2 * Channels * x;
+            __m256i taps[3];
+            Pairs::split(loadPixels256(src), loadPixels256(src + 8), taps[0], taps[1]);
+            if (Columns == 3) {
+                __m256i next;
+                Pairs::split(loadPixels256(src + Channels), loadPixels256(src + Channels + 8), next, taps[2]);
+            }
+            for (int i = 0; i < Columns; i++) {
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(weights256[j][i], _mm256_castsi256_ps(taps[i])));
+            }
+        }
+        _mm256_storeu_ps(dst + Channels * x, sum);
+    }
+#endif
+#if defined(MIPGEN_SSE2)
+    __m128 weights[3][3];
+    for (int j = 0; j < Rows; j++) {
+        for (int i = 0; i < Columns; i++) {
+            weights[j][i] = _mm_set1_ps(kernel.weights[j][i]);
+        }
+    }
+    // 4 channels per iteration
+    for (; Pairs::supported && x + 4 / Channels <= dst_width; x += 4 / Channels) {
+        __m128 sum = _mm_setzero_ps();
+        for (int j = 0; j < Rows; j++) {
+            const float* src = rows[j] + 2 * Channels * x;
+            __m128i taps[3];
+            Pairs::split(loadPixels(src), loadPixels(src + 4), taps[0], taps[1]);
+            if (Columns == 3) {
+                __m128i next;
+                Pairs::split(loadPixels(src + Channels), loadPixels(src + Channels + 4), next, taps[2]);
+            }
+            for (int i = 0; i < Columns; i++) {
+                sum = _mm_add_ps(sum, _mm_mul_ps(weights[j][i], _mm_castsi128_ps(taps[i])));
+            }
+        }
+        _mm_storeu_ps(dst + Channels * x, sum);
+    }
+#endif
+#if defined(MIPGEN_NEON)
+    // 4 channels per iteration
+    for (; Pairs::supported && x + 4 / Channels <= dst_width; x += 4 / Channels) {
+        float32x4_t sum = vdupq_n_f32(0.0f);
+        for (int j = 0; j < Rows; j++) {
+            const float* src = rows[j] + 2 * Channels * x;
+            uint8x16_t taps[3];
+            Pairs::split(loadPixels(src), loadPixels(src + 4), taps[0], taps[1]);
+            if (Columns == 3) {
+                uint8x16_t next;
+                Pairs::split(loadPixels(src + Channels), loadPixels(src + Channels + 4), next, taps[2]);
+            }
+            for (int i = 0; i < Columns; i++) {
+                sum = vaddq_f32(sum, vmulq_n_f32(vreinterpretq_f32_u8(taps[i]), kernel.weights[j][i]));
+            }
+        }
+        vst1q_f32(dst + Channels * x, sum);
+    }
+#endif
+    for (; x < dst_width; x++) {
+        for (int c = 0; c < Channels; c++) {
+            float sum = 0.0f;
+            for (int j = 0; j < Rows; j++) {
+                for (int i = 0; i < Columns; i++) {
+                    sum += kernel.weights[j][i] * rows[j][Channels * (2 * x + i) + c];
+                }
+            }
+            dst[Channels * x + c] = sum;
+        }
+    }
+}
+
+// Horizontal filter of the float row, keeps the filtered pixels as floats
+template <int Channels, int Columns>
+void filterHorizontalFloat(const float* acc, int dst_width, float* dst) {
+#if defined(MIPGEN_SSE2) || defined(MIPGEN_NEON)
+    typedef PixelPairs<4 * Channels> Pairs;
+#endif
+    int x = 0;
+#if defined(MIPGEN_AVX512)
+    // 16 channels per iteration
+    for (; Pairs::supported && x + 16 / Channels <= dst_width; x += 16 / Channels) {
+        const float* src = acc + 2 * Channels * x;
+        __m512i even, odd;
+        Pairs::split(loadPixels512(src), loadPixels512(src + 16), even, odd);
+        __m512 sum = _mm512_mul_ps(_mm512_set1_ps(tapWeight(Columns, 0)), _mm512_castsi512_ps(even));
+        if (Columns > 1) {
+            sum = _mm512_add_ps(sum, _mm512_mul_ps(_mm512_set1_ps(tapWeight(Columns, 1)), _mm512_castsi512_ps(odd)));
+        }
+        if (Columns == 3) {
+            __m512i next, third;
+            Pairs::split(loadPixels512(src + Channels), loadPixels512(src + Channels + 16), next, third);
+            sum = _mm512_add_ps(sum, _mm512_mul_ps(_mm512_set1_ps(tapWeight(Columns, 2)), _mm512_castsi512_ps(third)));
+        }
+        _mm512_storeu_ps(dst + Channels * x, sum);
+    }
+#endif
+#if defined(MIPGEN_AVX2)
+    // 8 channels per iteration
+    for (; Pairs::supported && x + 8 / Channels <= dst_width; x += 8 / Channels) {
+        const float* src = acc + 2 * Channels * x;
+        __m256i even, odd;
+        Pairs::split(loadPixels256(src), loadPixels256(src + 8), even, odd);
+        __m256 sum = _mm256_mul_ps(_mm256_set1_ps(tapWeight(Columns, 0)), _mm256_castsi256_ps(even));
+        if (Columns > 1) {
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(tapWeight(Columns, 1)), _mm256_castsi256_ps(odd)));
+        }
+        if (Columns == 3) {
+            __m256i next, third;
+            Pairs::split(loadPixels256(src + Channels), loadPixels256(src + Channels + 8), next, third);
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(tapWeight(Columns, 2)), _mm256_castsi256_ps(third)));
+        }
+        _mm256_storeu_ps(dst + Channels * x, sum);
+    }
+#endif
+#if defined(MIPGEN_SSE2)
+    // 4 channels per iteration
+    for (; Pairs::supported && x + 4 / Channels <= dst_width; x += 4 / Channels) {
+        const float* src = acc + 2 * Channels * x;
+        __m128i even, odd;
+        Pairs::split(loadPixels(src), loadPixels(src + 4), even, odd);
+        __m128 sum = _mm_mul_ps(_mm_set1_ps(tapWeight(Columns, 0)), _mm_castsi128_ps(even));
+        if (Columns > 1) {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(tapWeight(Columns, 1)), _mm_castsi128_ps(odd)));
+        }
+        if (Columns == 3) {
+            __m128i next, third;
+            Pairs::split(loadPixels(src + Channels), loadPixels(src + Channels + 4), next, third);
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(tapWeight(Columns, 2)), _mm_castsi128_ps(third)));
+        }
+        _mm_storeu_ps(dst + Channels * x, sum);
+    }
+#endif
+#if defined(MIPGEN_NEON)
+    // 4 channels per iteration
+    for (; Pairs::supported && x + 4 / Channels <= dst_width; x += 4 / Channels) {
+        const float* src = acc + 2 * Channels * x;
+        uint8x16_t even, odd;
+        Pairs::split(loadPixels(src), loadPixels(src + 4), even, odd);
+        float32x4_t sum = vmulq_n_f32(vreinterpretq_f32_u8(even), tapWeight(Columns, 0));
+        if (Columns > 1) {
+            sum = vaddq_f32(sum, vmulq_n_f32(vreinterpretq_f32_u8(odd), tapWeight(Columns, 1)));
+        }
+        if (Columns == 3) {
+            uint8x16_t next, third;
+            Pairs::split(loadPixels(src + Channels), loadPixels(src + Channels + 4), next, third);
+            sum = vaddq_f32(sum, vmulq_n_f32(vreinterpretq_f32_u8(third), tapWeight(Columns, 2)));
+        }
+        vst1q_f32(dst + Channels * x, sum);
+    }
+#endif
+    for (; x < dst_width; x++) {
+        for (int c = 0; c < Channels; c++) {
+            float sum = 0.0f;
+            for (int i = 0; i < Columns; i++) {
+                sum += tapWeight(Columns, i) * acc[Channels * (2 * x + i) + c];
+            }
+            dst[Channels * x + c] = sum;
+        }
+    }
+}
+
+// acc[i] = sum(weight[j] * decode(rows[j], i)) for every channel i of the first pixels of rows.
+// decode converts the channel to float (to linear through the sRGB tables when Srgb, alpha is already linear)
+// and, when Premultiply, multiplies the color by alpha / 255 (exactly 1 for opaque pixels)
+template <int Channels, bool Srgb, bool Premultiply, int Rows>
+void decodeVertical(const unsigned char* const* rows, int pixels, float* acc) {
+    const int alpha = alphaChannel(Channels);
+    const int count = pixels * Channels;
+    const float* to_linear = srgbToLinearTable();
+#if defined(MIPGEN_SSE2)
+    // The SIMD loops work on RGBA pixels, or on any of them when all the channels are decoded the same way
+    const bool simd = Channels == 4 || (!Srgb && !Premultiply);
+#endif
+    int i = 0;
+#if defined(MIPGEN_AVX2)
+    const __m256i channel_tables = _mm256_setr_epi32(0, 256, 512, 768, 0, 256, 512, 768);
+    // Two pixels per iteration
+    for (; simd && i + 8 <= count; i += 8) {
+        __m256 sum = _mm256_setzero_ps();
+        for (int j = 0; j < Rows; j++) {
+            const __m256i bytes = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(rows[j] + i)));
+            __m256 values = Srgb ? _mm256_i32gather_ps(to_linear, _mm256_add_epi32(bytes, channel_tables), 4)
+                                 : _mm256_cvtepi32_ps(bytes);
+            if (Premultiply) {
+                const __m256 alpha = _mm256_shuffle_ps(values, values, _MM_SHUFFLE(3, 3, 3, 3));
+                const __m256 color = _mm256_mul_ps(values, _mm256_div_ps(alpha, _mm256_set1_ps(255.0f)));
+                values = _mm256_blend_ps(color, values, 0x88);
+            }
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(tapWeight(Rows, j)), values));
+        }
+        _mm256_storeu_ps(acc + i, sum);
+    }
+#endif
+#if defined(MIPGEN_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 color_mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+    // One pixel per iteration
+    for (; simd && i + 4 <= count; i += 4) {
+        __m128 sum = _mm_setzero_ps();
+        for (int j = 0; j < Rows; j++) {
+            const unsigned char* src = rows[j] + i;
+            __m128 values;
+            if (Srgb) {
+                values = _mm_setr_ps(to_linear[src[0]], to_linear[256 + src[1]], to_linear[512 + src[2]], src[3]);
+            } else {
+                int pixel;
+                std::memcpy(&pixel, src, sizeof(pixel));
+                values = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(pixel), zero), zero));
+            }
+            if (Premultiply) {
+                const __m128 alpha = _mm_shuffle_ps(values, values, _MM_SHUFFLE(3, 3, 3, 3));
+                const __m128 color = _mm_mul_ps(values, _mm_div_ps(alpha, _mm_set1_ps(255.0f)));
+                values = _mm_or_ps(_mm_and_ps(color_mask, color), _mm_andnot_ps(color_mask, values));
+            }
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(tapWeight(Rows, j)), values));
+        }
+        _mm_storeu_ps(acc + i, sum);
+    }
+#endif
+    for (; i < count; i++) {
+        const int c = i % Channels;
+        float sum = 0.0f;
+        for (int j = 0; j < Rows; j++) {
+            const unsigned char* src = rows[j] + i;
+            // The color tables are all the same
+            float value = Srgb ? to_linear[(c == alpha ? 768 : 0) + src[0]] : src[0];
+            if (Premultiply && alpha >= 0 && c != alpha) {
+                value *= src[alpha - c] / 255.0f;
+            }
+            sum += tapWeight(Rows, j) * value;
+        }
+        acc[i] = sum;
+    }
+}
+
+// Bytes of a row of filtered pixels. When Premultiplied the color is divided by alpha / 255 first
+// (0 where alpha is 0). Everything is clamped in [0, 255] and truncated like writeToPixel (rounded to the
+// nearest when Round), except the color of Srgb rows that is rounded to the nearest entry of the linear to
+// sRGB table. Negative lobes (i. e. sinc or Catmull-Rom) end up as 0
+template <int Channels, bool Srgb, bool Premultiplied, bool Round>
+void encodeRow(const float* src, int pixels, unsigned char* dst) {
+    const int alpha = alphaChannel(Channels);
+    const float rounding = Round ? 0.5f : 0.0f;
+    const int count = pixels * Channels;
+    const unsigned char* to_srgb = linearToSrgbTable();
+    const float scale = (kLinearToSrgbSize - 1) / 255.0f;
+#if defined(MIPGEN_SSE2)
+    const bool simd = Channels == 4 || (!Srgb && !Premultiplied);
+#endif
+    int i = 0;
+#if defined(MIPGEN_AVX2)
+    // Two pixels per iteration. The gather reads 4 bytes at every index (the table is padded) and keeps the first one
+    for (; simd && i + 8 <= count; i += 8) {
+        __m256 value = _mm256_loadu_ps(src + i);
+        if (Premultiplied) {
+            const __m256 alpha = _mm256_shuffle_ps(value, value, _MM_SHUFFLE(3, 3, 3, 3));
+            const __m256 color = _mm256_and_ps(_mm256_mul_ps(value, _mm256_div_ps(_mm256_set1_ps(255.0f), alpha)),
+                                               _mm256_cmp_ps(alpha, _mm256_setzero_ps(), _CMP_GT_OQ));
+            value = _mm256_blend_ps(color, value, 0x88);
+        }
+        value = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(255.0f));
+        __m256i ints = _mm256_cvttps_epi32(Round ? _mm256_add_ps(value, _mm256_set1_ps(rounding)) : value);
+        if (Srgb) {
+            const __m256i index = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(value, _mm256_set1_ps(scale)), _mm256_set1_ps(0.5f)));
+            const __m256i srgb = _mm256_and_si256(_mm256_i32gather_epi32(reinterpret_cast<const int*>(to_srgb), index, 1),
+                                                  _mm256_set1_epi32(0xFF));
+            ints = _mm256_blend_epi32(srgb, ints, 0x88);
+        }
+        __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(ints), _mm256_extracti128_si256(ints, 1));
+        packed = _mm_packus_epi16(packed, packed);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), packed);
+    }
+#endif
+#if defined(MIPGEN_SSE2)
+    const __m128 color_mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+    // One pixel per iteration
+    for (; simd && i + 4 <= count; i += 4) {
+        __m128 value = _mm_loadu_ps(src + i);
+        if (Premultiplied) {
+            const __m128 alpha = _mm_shuffle_ps(value, value, _MM_SHUFFLE(3, 3, 3, 3));
+            const __m128 color = _mm_and_ps(_mm_mul_ps(value, _mm_div_ps(_mm_set1_ps(255.0f), alpha)),
+                                            _mm_cmpgt_ps(alpha, _mm_setzero_ps()));
+            value = _mm_or_ps(_mm_and_ps(color_mask, color), _mm_andnot_ps(color_mask, value));
+        }
+        value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+        const __m128i ints = _mm_cvttps_epi32(Round ? _mm_add_ps(value, _mm_set1_ps(rounding)) : value);
+        if (Srgb) {
+            alignas(16) int index[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(index),
+                            _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(scale)), _mm_set1_ps(0.5f))));
+            dst[i] = to_srgb[index[0]];
+            dst[i + 1] = to_srgb[index[1]];
+            dst[i + 2] = to_srgb[index[2]];
+            dst[i + 3] = static_cast<unsigned char>(_mm_cvtsi128_si32(_mm_shuffle_epi32(ints, _MM_SHUFFLE(3, 3, 3, 3))));
+        } else {
+            __m128i packed = _mm_packs_epi32(ints, ints);
+            packed = _mm_packus_epi16(packed, packed);
+            const int pixel = _mm_cvtsi128_si32(packed);
+            std::memcpy(dst + i, &pixel, sizeof(pixel));
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        const int c = i % Channels;
+        float value = src[i];
+        if (Premultiplied && alpha >= 0 && c != alpha) {
+            const float pixel_alpha = src[i - c + alpha];
+            value = pixel_alpha > 0.0f ? value * (255.0f / pixel_alpha) : 0.0f;
+        }
+        value = value < 0.0f ? 0.0f : (value > 255.0f ? 255.0f : value);
+        dst[i] = (Srgb && c != alpha) ? to_srgb[static_cast<int>(value * scale + 0.5f)] : static_cast<unsigned char>(value + rounding);
+    }
+}
+
+// Normal maps store each component n in [-1, 1] as (n + 1) * 255 / 2. They are filtered as vectors:
+// decodeNormalVertical sums the decoded normals like decodeVertical (z is rebuilt from x and y when Rg),
+// alpha is kept as it is. Whatever the channels of the pixels, the filtered values are x, y, z and alpha
+// (0 without alpha), so the averaged z is there to renormalize even when it is not stored
+template <int Channels, bool Rg, int Rows>
+void decodeNormalVertical(const unsigned char* const* rows, int pixels, float* acc) {
+    const float scale = 2.0f / 255.0f;
+    int p = 0;
+#if defined(MIPGEN_AVX2)
+    const __m256 bias = _mm256_setr_ps(-1.0f, -1.0f, -1.0f, 0.0f, -1.0f, -1.0f, -1.0f, 0.0f);
+    const __m256 lane_scale = _mm256_setr_ps(scale, scale, scale, 1.0f, scale, scale, scale, 1.0f);
+    // Two pixels per iteration, RGBA ones or RG ones spread to the lanes of RGBA
+    for (; (Channels == 2 || Channels == 4) && p + 2 <= pixels; p += 2) {
+        __m256 sum = _mm256_setzero_ps();
+        for (int j = 0; j < Rows; j++) {
+            __m128i two_pixels;
+            if (Channels == 4) {
+                two_pixels = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(rows[j] + 4 * p));
+            } else {
+                int pair;
+                std::memcpy(&pair, rows[j] + 2 * p, sizeof(pair));
+                two_pixels = _mm_unpacklo_epi16(_mm_cvtsi32_si128(pair), _mm_setzero_si128());
+            }
+            const __m256i bytes = _mm256_cvtepu8_epi32(two_pixels);
+            __m256 normal = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(bytes), lane_scale), bias);
+            if (Rg) {
+                // z = sqrt(1 - x^2 - y^2)
+                const __m256 squares = _mm256_mul_ps(normal, normal);
+                const __m256 xy = _mm256_add_ps(squares, _mm256_shuffle_ps(squares, squares, _MM_SHUFFLE(3, 2, 0, 1)));
+                const __m256 z = _mm256_sqrt_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), xy), _mm256_setzero_ps()));
+                normal = _mm256_blend_ps(normal, _mm256_shuffle_ps(z, z, _MM_SHUFFLE(0, 0, 0, 0)), 0x44);
+            }
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(tapWeight(Rows, j)), normal));
+        }
+        _mm256_storeu_ps(acc + 4 * p, sum);
+    }
+#endif
+#if defined(MIPGEN_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 bias4 = _mm_setr_ps(-1.0f, -1.0f, -1.0f, 0.0f);
+    const __m128 lane_scale4 = _mm_setr_ps(scale, scale, scale, 1.0f);
+    const __m128 z_mask = _mm_castsi128_ps(_mm_setr_epi32(0, 0, -1, 0));
+    // One pixel per iteration, the channels it does not have are 0 (z is rebuilt when it has no B)
+    for (; p < pixels; p++) {
+        __m128 sum = _mm_setzero_ps();
+        for (int j = 0; j < Rows; j++) {
+            // Put together in a register: loading a partially copied int would stall on the copy
+            const unsigned char* src = rows[j] + Channels * p;
+            int pixel;
+            if (Channels == 4) {
+                std::memcpy(&pixel, src, sizeof(pixel));
+            } else {
+                pixel = src[0] | src[1] << 8 | (Channels == 3 ? src[2] << 16 : 0);
+            }
+            const __m128 bytes = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(pixel), zero), zero));
+            __m128 normal = _mm_add_ps(_mm_mul_ps(bytes, lane_scale4), bias4);
+            if (Rg) {
+                const __m128 squares = _mm_mul_ps(normal, normal);
+                const __m128 xy = _mm_add_ps(squares, _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(3, 2, 0, 1)));
+                __m128 z = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(1.0f), xy), _mm_setzero_ps()));
+                z = _mm_shuffle_ps(z, z, _MM_SHUFFLE(0, 0, 0, 0));
+                normal = _mm_or_ps(_mm_and_ps(z_mask, z), _mm_andnot_ps(z_mask, normal));
+            }
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(tapWeight(Rows, j)), normal));
+        }
+        _mm_storeu_ps(acc + 4 * p, sum);
+    }
+#endif
+    for (; p < pixels; p++) {
+        float sum[4] = {};
+        for (int j = 0; j < Rows; j++) {
+            const unsigned char* src = rows[j] + Channels * p;
+            const float x = src[0] * scale - 1.0f;
+            const float y = src[1] * scale - 1.0f;
+            const float z = Rg ? std::sqrt(std::max(1.0f - (x * x + y * y), 0.0f)) : src[2] * scale - 1.0f;
+            sum[0] += tapWeight(Rows, j) * x;
+            sum[1] += tapWeight(Rows, j) * y;
+            sum[2] += tapWeight(Rows, j) * z;
+            if (Channels == 4) {
+                sum[3] += tapWeight(Rows, j) * src[3];
+            }
+        }
+        std::memcpy(acc + 4 * p, sum, sizeof(sum));
+    }
+}
+
+// Scalar version of encodeNormalRow for a single pixel, writes the first Channels channels
+template <int Channels, bool Rg, bool StoreLength>
+void encodeNormal(const float* src, float alpha_bias, unsigned char* dst) {
+    const float dot = src[0] * src[0] + src[1] * src[1] + src[2] * src[2];
+    const bool valid = dot > 1e-12f;
+    const float r = valid ? 1.0f / std::sqrt(dot) : 0.0f;
+    float encoded[4] = {
+        (valid ? src[0] * r : 0.0f) * 127.5f + 127.5f + 0.5f,
+        (valid ? src[1] * r : 0.0f) * 127.5f + 127.5f + 0.5f,
+        (valid ? src[2] * r : 1.0f) * 127.5f + 127.5f + 0.5f,
+        src[3] + alpha_bias
+    };
+    if (StoreLength) {
+        encoded[Rg ? 2 : 3] = dot * r * 255.0f + 0.5f;
+    }
+    for (int c = 0; c < Channels; c++) {
+        const float value = encoded[c] < 0.0f ? 0.0f : (encoded[c] > 255.0f ? 255.0f : encoded[c]);
+        dst[c] = static_cast<unsigned char>(value);
+    }
+}
+
+// Renormalizes and encodes a row of filtered normals (x, y, z and alpha) into pixels of Channels channels.
+// The normals are rounded to the nearest byte, alpha is truncated like in encodeRow (unless Round).
+// With StoreLength the length of the filtered normal (shorter the more the normals of the footprint disagree)
+// goes to B when Rg, or to A otherwise.
+// 1 / length is rsqrt plus a Newton-Raphson step (~23 bits): the SIMD paths may round a component
+// differently than the scalar one, which uses 1 / sqrt
+template <int Channels, bool Rg, bool StoreLength, bool Round>
+void encodeNormalRow(const float* src, int pixels, unsigned char* dst) {
+    // Rounding bias of alpha: truncated unless it has the length or Round
+    const float alpha_bias = ((StoreLength && !Rg) || Round) ? 0.5f : 0.0f;
+    int p = 0;
+#if defined(MIPGEN_AVX2)
+    const int length_mask = Rg ? 0x44 : 0x88;
+    const __m256 xyz_mask = _mm256_castsi256_ps(_mm256_setr_epi32(-1, -1, -1, 0, -1, -1, -1, 0));
+    const __m256 bias = _mm256_setr_ps(0.5f, 0.5f, 0.5f, alpha_bias, 0.5f, 0.5f, 0.5f, alpha_bias);
+    // Two pixels per iteration, RGBA ones or the first two channels of each one for RG
+    for (; (Channels == 2 || Channels == 4) && p + 2 <= pixels; p += 2) {
+        const __m256 value = _mm256_loadu_ps(src + 4 * p);
+        // x^2 + y^2 + z^2 in every lane of the pixel
+        const __m256 squares = _mm256_and_ps(_mm256_mul_ps(value, value), xyz_mask);
+        __m256 dot = _mm256_add_ps(squares, _mm256_shuffle_ps(squares, squares, _MM_SHUFFLE(2, 3, 0, 1)));
+        dot = _mm256_add_ps(dot, _mm256_shuffle_ps(dot, dot, _MM_SHUFFLE(1, 0, 3, 2)));
+        // r = rsqrt(dot), r' = r * (1.5 - 0.5 * dot * r * r)
+        const __m256 valid = _mm256_cmp_ps(dot, _mm256_set1_ps(1e-12f), _CMP_GT_OQ);
+        __m256 r = _mm256_rsqrt_ps(_mm256_max_ps(dot, _mm256_set1_ps(1e-12f)));
+        r = _mm256_mul_ps(r, _mm256_sub_ps(_mm256_set1_ps(1.5f), _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), dot), _mm256_mul_ps(r, r))));
+        // Normals that cancel out become (0, 0, 1)
+        __m256 normal = _mm256_blendv_ps(_mm256_setr_ps(0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f), _mm256_mul_ps(value, r), valid);
+        normal = _mm256_add_ps(_mm256_mul_ps(normal, _mm256_set1_ps(127.5f)), _mm256_set1_ps(127.5f));
+        __m256 encoded = _mm256_blend_ps(normal, value, 0x88);
+        if (StoreLength) {
+            const __m256 length = _mm256_and_ps(_mm256_mul_ps(_mm256_mul_ps(dot, r), _mm256_set1_ps(255.0f)), valid);
+            encoded = _mm256_blend_ps(encoded, length, length_mask);
+        }
+        encoded = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(encoded, bias), _mm256_setzero_ps()), _mm256_set1_ps(255.0f));
+        const __m256i ints = _mm256_cvttps_epi32(encoded);
+        __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(ints), _mm256_extracti128_si256(ints, 1));
+        packed = _mm_packus_epi16(packed, packed);
+        if (Channels == 4) {
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + 4 * p), packed);
+        } else {
+            // x and y of both pixels are the 16 bit words 0 and 2
+            const int pair = _mm_cvtsi128_si32(_mm_shufflelo_epi16(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+            std::memcpy(dst + 2 * p, &pair, sizeof(pair));
+        }
+    }
+#endif
+#if defined(MIPGEN_SSE2)
+    const __m128 xyz_mask4 = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+    const __m128 length_mask4 = _mm_castsi128_ps(Rg ? _mm_setr_epi32(0, 0, -1, 0) : _mm_setr_epi32(0, 0, 0, -1));
+    const __m128 bias4 = _mm_setr_ps(0.5f, 0.5f, 0.5f, alpha_bias);
+    // One pixel per iteration, the first Channels bytes are written
+    for (; p < pixels; p++) {
+        const __m128 value = _mm_loadu_ps(src + 4 * p);
+        const __m128 squares = _mm_and_ps(_mm_mul_ps(value, value), xyz_mask4);
+        __m128 dot = _mm_add_ps(squares, _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(2, 3, 0, 1)));
+        dot = _mm_add_ps(dot, _mm_shuffle_ps(dot, dot, _MM_SHUFFLE(1, 0, 3, 2)));
+        const __m128 valid = _mm_cmpgt_ps(dot, _mm_set1_ps(1e-12f));
+        __m128 r = _mm_rsqrt_ps(_mm_max_ps(dot, _mm_set1_ps(1e-12f)));
+        r = _mm_mul_ps(r, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), dot), _mm_mul_ps(r, r))));
+        __m128 normal = _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(value, r)),
+                                  _mm_andnot_ps(valid, _mm_setr_ps(0.0f, 0.0f, 1.0f, 0.0f)));
+        normal = _mm_add_ps(_mm_mul_ps(normal, _mm_set1_ps(127.5f)), _mm_set1_ps(127.5f));
+        __m128 encoded = _mm_or_ps(_mm_and_ps(xyz_mask4, normal), _mm_andnot_ps(xyz_mask4, value));
+        if (StoreLength) {
+            const __m128 length = _mm_and_ps(_mm_mul_ps(_mm_mul_ps(dot, r), _mm_set1_ps(255.0f)), valid);
+            encoded = _mm_or_ps(_mm_and_ps(length_mask4, length), _mm_andnot_ps(length_mask4, encoded));
+        }
+        encoded = _mm_min_ps(_mm_max_ps(_mm_add_ps(encoded, bias4), _mm_setzero_ps()), _mm_set1_ps(255.0f));
+        __m128i packed = _mm_cvttps_epi32(encoded);
+        packed = _mm_packs_epi32(packed, packed);
+        packed = _mm_packus_epi16(packed, packed);
+        const int pixel = _mm_cvtsi128_si32(packed);
+        std::memcpy(dst + Channels * p, &pixel, Channels);
+    }
+#endif
+    for (; p < pixels; p++) {
+        encodeNormal<Channels, Rg, StoreLength>(src + 4 * p, alpha_bias, dst + Channels * p);
+    }
+}
+
+// Channels of half (uint16_t) and single float rows as floats
+inline float loadChannel(const float* src) {
+    return *src;
+}
+
+inline float loadChannel(const uint16_t* src) {
+    return halfToFloat(*src);
+}
+
+inline void storeChannel(float* dst, float value) {
+    *dst = value;
+}
+
+inline void storeChannel(uint16_t* dst, float value) {
+    *dst = floatToHalf(value);
+}
+
+#if defined(MIPGEN_AVX2)
+inline __m256 loadChannels8(const float* src) {
+    return _mm256_loadu_ps(src);
+}
+
+inline __m256 loadChannels8(const uint16_t* src) {
+#if defined(MIPGEN_F16C)
+    return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+#else
+    return _mm256_setr_ps(halfToFloat(src[0]), halfToFloat(src[1]), halfToFloat(src[2]), halfToFloat(src[3]),
+                          halfToFloat(src[4]), halfToFloat(src[5]), halfToFloat(src[6]), halfToFloat(src[7]));
+#endif
+}
+
+inline void storeChannels8(float* dst, __m256 value) {
+    _mm256_storeu_ps(dst, value);
+}
+
+inline void storeChannels8(uint16_t* dst, __m256 value) {
+#if defined(MIPGEN_F16C)
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm256_cvtps_ph(value, _MM_FROUND_TO_NEAREST_INT));
+#else
+    alignas(32) float values[8];
+    _mm256_store_ps(values, value);
+    for (int i = 0; i < 8; i++) {
+        dst[i] = floatToHalf(values[i]);
+    }
+#endif
+}
+#endif
+
+#if defined(MIPGEN_SSE2)
+inline __m128 loadChannels4(const float* src) {
+    return _mm_loadu_ps(src);
+}
+
+inline __m128 loadChannels4(const uint16_t* src) {
+#if defined(MIPGEN_F16C)
+    return _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src)));
+#else
+    return _mm_setr_ps(halfToFloat(src[0]), halfToFloat(src[1]), halfToFloat(src[2]), halfToFloat(src[3]));
+#endif
+}
+
+inline void storeChannels4(float* dst, __m128 value) {
+    _mm_storeu_ps(dst, value);
+}
+
+inline void storeChannels4(uint16_t* dst, __m128 value) {
+#if defined(MIPGEN_F16C)
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_cvtps_ph(value, _MM_FROUND_TO_NEAREST_INT));
+#else
+    alignas(16) float values[4];
+    _mm_store_ps(values, value);
+    for (int i = 0; i < 4; i++) {
+        dst[i] = floatToHalf(values[i]);
+    }
+#endif
+}
+#endif
+
+// Half (T = uint16_t) and single float images hold linear HDR values: they are filtered as they are,
+// without sRGB, premultiplied alpha nor clamping. acc[i] = sum(weight[j] * rows[j][i])
+template <typename T, int Channels, int Rows>
+void decodeFloatVertical(const unsigned char* const* rows, int pixels, float* acc) {
+    const int count = pixels * Channels;
+    const T* channels[3];
+    for (int j = 0; j < Rows; j++) {
+        channels[j] = reinterpret_cast<const T*>(rows[j]);
+    }
+    int i = 0;
+#if defined(MIPGEN_AVX2)
+    for (; i + 8 <= count; i += 8) {
+        __m256 sum = _mm256_setzero_ps();
+        for (int j = 0; j < Rows; j++) {
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(tapWeight(Rows, j)), loadChannels8(channels[j] + i)));
+        }
+        _mm256_storeu_ps(acc + i, sum);
+    }
+#endif
+#if defined(MIPGEN_SSE2)
+    for (; i + 4 <= count; i += 4) {
+        __m128 sum = _mm_setzero_ps();
+        for (int j = 0; j < Rows; j++) {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(tapWeight(Rows, j)), loadChannels4(channels[j] + i)));
+        }
+        _mm_storeu_ps(acc + i, sum);
+    }
+#endif
+    for (; i < count; i++) {
+        float sum = 0.0f;
+        for (int j = 0; j < Rows; j++) {
+            sum += tapWeight(Rows, j) * loadChannel(channels[j] + i);
+        }
+        acc[i] = sum;
+    }
+}
+
+// Stores a row of filtered values as half (rounded to nearest even) or single floats
+template <typename T, int Channels>
+void encodeFloatRow(const float* src, int pixels, unsigned char* dst) {
+    const int count = pixels * Channels;
+    T* channels = reinterpret_cast<T*>(dst);
+    int i = 0;
+#if defined(MIPGEN_AVX2)
+    for (; i + 8 <= count; i += 8) {
+        storeChannels8(channels + i, _mm256_loadu_ps(src + i));
+    }
+#endif
+#if defined(MIPGEN_SSE2)
+    for (; i + 4 <= count; i += 4) {
+        storeChannels4(channels + i, _mm_loadu_ps(src + i));
+    }
+#endif
+    for (; i < count; i++) {
+        storeChannel(channels + i, src[i]);
+    }
+}
+
+// 16 bit images hold data (heightmaps, masks), filtered as they are like the HDR ones.
+// acc[i] = sum(weight[j] * rows[j][i])
+template <int Channels, int Rows>
+void decodeUNorm16Vertical(const unsigned char* const* rows, int pixels, float* acc) {
+    const int count = pixels * Channels;
+    const uint16_t* channels[3];
+    for (int j = 0; j < Rows; j++) {
+        channels[j] = reinterpret_cast<const uint16_t*>(rows[j]);
+    }
+    int i = 0;
+#if defined(MIPGEN_AVX2)
+    for (; i + 8 <= count; i += 8) {
+        __m256 sum = _mm256_setzero_ps();
+        for (int j = 0; j < Rows; j++) {
+            const __m256i values = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(channels[j] + i)));
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(tapWeight(Rows, j)), _mm256_cvtepi32_ps(values)));
+        }
+        _mm256_storeu_ps(acc + i, sum);
+    }
+#endif
+#if defined(MIPGEN_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        __m128 sum = _mm_setzero_ps();
+        for (int j = 0; j < Rows; j++) {
+            const __m128i values = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(channels[j] + i)), zero);
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(tapWeight(Rows, j)), _mm_cvtepi32_ps(values)));
+        }
+        _mm_storeu_ps(acc + i, sum);
+    }
+#endif
+    for (; i < count; i++) {
+        float sum = 0.0f;
+        for (int j = 0; j < Rows; j++) {
+            sum += tapWeight(Rows, j) * channels[j][i];
+        }
+        acc[i] = sum;
+    }
+}
+
+// Clamped in [0, 65535] and truncated (or rounded), like encodeRow does with the bytes
+template <int Channels, bool Round>
+void encodeUNorm16Row(const float* src, int pixels, unsigned char* dst) {
+    const int count = pixels * Channels;
+    const float rounding = Round ? 0.5f : 0.0f;
+    uint16_t* channels = reinterpret_cast<uint16_t*>(dst);
+    int i = 0;
+#if defined(MIPGEN_AVX2)
+    for (; i + 8 <= count; i += 8) {
+        const __m256 value = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), _mm256_setzero_ps()), _mm256_set1_ps(65535.0f));
+        const __m256i ints = _mm256_cvttps_epi32(Round ? _mm256_add_ps(value, _mm256_set1_ps(rounding)) : value);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(channels + i),
+                         _mm_packus_epi32(_mm256_castsi256_si128(ints), _mm256_extracti128_si256(ints, 1)));
+    }
+#endif
+#if defined(MIPGEN_SSE2)
+    const __m128i bias32 = _mm_set1_epi32(32768);
+    const __m128i bias16 = _mm_set1_epi16(-32768);
+    for (; i + 4 <= count; i += 4) {
+        const __m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), _mm_setzero_ps()), _mm_set1_ps(65535.0f));
+        const __m128i ints = _mm_sub_epi32(_mm_cvttps_epi32(Round ? _mm_add_ps(value, _mm_set1_ps(rounding)) : value), bias32);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(channels + i), _mm_add_epi16(_mm_packs_epi32(ints, ints), bias16));
+    }
+#endif
+    for (; i < count; i++) {
+        const float value = src[i] < 0.0f ? 0.0f : (src[i] > 65535.0f ? 65535.0f : src[i]);
+        channels[i] = static_cast<uint16_t>(value + rounding);
+    }
+}
+
+template <int Channels, bool Srgb, bool Premultiply>
+RowCodec colorCodec() {
+    return { { decodeVertical<Channels, Srgb, Premultiply, 1>, decodeVertical<Channels, Srgb, Premultiply, 2>,
+               decodeVertical<Channels, Srgb, Premultiply, 3> },
+             encodeRow<Channels, Srgb, Premultiply, false>, encodeRow<Channels, Srgb, Premultiply, true>, Channels };
+}
+
+template <int Channels, bool Rg, bool StoreLength>
+RowCodec normalCodec() {
+    return { { decodeNormalVertical<Channels, Rg, 1>, decodeNormalVertical<Channels, Rg, 2>, decodeNormalVertical<Channels, Rg, 3> },
+             encodeNormalRow<Channels, Rg, StoreLength, false>, encodeNormalRow<Channels, Rg, StoreLength, true>, 4 };
+}
+
+template <typename T, int Channels>
+RowCodec floatCodec() {
+    return { { decodeFloatVertical<T, Channels, 1>, decodeFloatVertical<T, Channels, 2>, decodeFloatVertical<T, Channels, 3> },
+             encodeFloatRow<T, Channels>, encodeFloatRow<T, Channels>, Channels };
+}
+
+template <int Channels>
+RowCodec unorm16Codec() {
+    return { { decodeUNorm16Vertical<Channels, 1>, decodeUNorm16Vertical<Channels, 2>, decodeUNorm16Vertical<Channels, 3> },
+             encodeUNorm16Row<Channels, false>, encodeUNorm16Row<Channels, true>, Channels };
+}
+
+template <int Channels>
+RowCodec channelCodec(const CPUMipMapOptions& options, PixelFormat format) {
+    if (format == PixelFormat::Float16) {
+        return floatCodec<uint16_t, Channels>();
+    }
+    if (format == PixelFormat::Float32) {
+        return floatCodec<float, Channels>();
+    }
+    if (format == PixelFormat::UNorm16) {
+        return unorm16Codec<Channels>();
+    }
+    // Normals are not colors: no sRGB nor premultiplied alpha for them
+    if (options.normal_map != NormalMap::None) {
+        static const RowCodec normal_codecs[2][2] = {
+            { normalCodec<Channels, false, false>(), normalCodec<Channels, false, true>() },
+            { normalCodec<Channels, true, false>(), normalCodec<Channels, true, true>() }
+        };
+        return normal_codecs[options.normal_map == NormalMap::RG ? 1 : 0][options.normal_length ? 1 : 0];
+    }
+    // Without alpha there is nothing to premultiply by
+    constexpr bool has_alpha = alphaChannel(Channels) >= 0;
+    static const RowCodec codecs[2][2] = {
+        { colorCodec<Channels, false, false>(), colorCodec<Channels, false, has_alpha>() },
+        { colorCodec<Channels, true, false>(), colorCodec<Channels, true, has_alpha>() }
+    };
+    return codecs[options.srgb ? 1 : 0][options.premultiplied_alpha ? 1 : 0];
+}
+
+RowCodec rowCodec(const CPUMipMapOptions& options, PixelFormat format, int channels) {
+    switch (channels) {
+    case 1:
+        return channelCodec<1>(options, format);
+    case 2:
+        return channelCodec<2>(options, format);
+    case 3:
+        return channelCodec<3>(options, format);
+    default:
+        return channelCodec<4>(options, format);
+    }
+}
+
+// 2x2 box filter of a region of pixels with Channels channels (GenerateMip.hlsl computePixelEvenEven).
+// floor((p0 + p1 + p2 + p3) / 4), the same value the float path truncates to
+template <int Channels>
+void boxReduce(const unsigned char* src, ptrdiff_t src_pitch, unsigned char* dst, ptrdiff_t dst_pitch,
+               int dst_width, int dst_height) {
+#if defined(MIPGEN_SSE2) || defined(MIPGEN_NEON)
+    typedef PixelPairs<2 * Channels> Pairs;
+#endif
+    for (int y = 0; y < dst_height; y++) {
+        const unsigned char* row0 = src + (2 * y) * src_pitch;
+        const unsigned char* row1 = row0 + src_pitch;
+        unsigned char* out = dst + y * dst_pitch;
+        int x = 0;
+#if defined(MIPGEN_AVX512)
+        // 32 destination channels per iteration
+        for (; Pairs::supported && x + 32 / Channels <= dst_width; x += 32 / Channels) {
+            const unsigned char* a = row0 + 2 * Channels * x;
+            const unsigned char* b = row1 + 2 * Channels * x;
+            const __m512i lo = _mm512_add_epi16(_mm512_cvtepu8_epi16(loadPixels256(a)), _mm512_cvtepu8_epi16(loadPixels256(b)));
+            const __m512i hi = _mm512_add_epi16(_mm512_cvtepu8_epi16(loadPixels256(a + 32)), _mm512_cvtepu8_epi16(loadPixels256(b + 32)));
+            __m512i even, odd;
+            Pairs::split(lo, hi, even, odd);
+            const __m512i sum = _mm512_srli_epi16(_mm512_add_epi16(even, odd), 2);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + Channels * x), _mm512_cvtepi16_epi8(sum));
+        }
+#endif
+#if defined(MIPGEN_AVX2)
+        // 16 destination channels per iteration, 16 bits per channel
+        for (; Pairs::supported && x + 16 / Channels <= dst_width; x += 16 / Channels) {
+            const unsigned char* a = row0 + 2 * Channels * x;
+            const unsigned char* b = row1 + 2 * Channels * x;
+            const __m256i lo = _mm256_add_epi16(_mm256_cvtepu8_epi16(loadPixels(a)), _mm256_cvtepu8_epi16(loadPixels(b)));
+            const __m256i hi = _mm256_add_epi16(_mm256_cvtepu8_epi16(loadPixels(a + 16)), _mm256_cvtepu8_epi16(loadPixels(b + 16)));
+            __m256i even, odd;
+            Pairs::split(lo, hi, even, odd);
+            const __m256i sum = _mm256_srli_epi16(_mm256_add_epi16(even, odd), 2);
+            const __m256i packed = _mm256_packus_epi16(sum, _mm256_setzero_si256());
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + Channels * x),
+                             _mm_unpacklo_epi64(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1)));
+        }
+#endif
+#if defined(MIPGEN_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        // 8 destination channels per iteration
+        for (; Pairs::supported && x + 8 / Channels <= dst_width; x += 8 / Channels) {
+            const __m128i a = loadPixels(row0 + 2 * Channels * x);
+            const __m128i b = loadPixels(row1 + 2 * Channels * x);
+            const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+            __m128i even, odd;
+            Pairs::split(lo, hi, even, odd);
+            const __m128i sum = _mm_srli_epi16(_mm_add_epi16(even, odd), 2);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + Channels * x), _mm_packus_epi16(sum, sum));
+        }
+#endif
+#if defined(MIPGEN_NEON)
+        // 8 destination channels per iteration
+        for (; Pairs::supported && x + 8 / Channels <= dst_width; x += 8 / Channels) {
+            const unsigned char* a = row0 + 2 * Channels * x;
+            const unsigned char* b = row1 + 2 * Channels * x;
+            const uint16x8_t lo = vaddl_u8(vld1_u8(a), vld1_u8(b));
+            const uint16x8_t hi = vaddl_u8(vld1_u8(a + 8), vld1_u8(b + 8));
+            uint8x16_t even, odd;
+            Pairs::split(vreinterpretq_u8_u16(lo), vreinterpretq_u8_u16(hi), even, odd);
+            vst1_u8(out + Channels * x, vshrn_n_u16(vaddq_u16(vreinterpretq_u16_u8(even), vreinterpretq_u16_u8(odd)), 2));
+        }
+#endif
+        for (; x < dst_width; x++) {
+            for (int c = 0; c < Channels; c++) {
+                const int i = 2 * Channels * x + c;
+                const int sum = row0[i] + row0[i + Channels] + row1[i] + row1[i + Channels];
+                out[Channels * x + c] = static_cast<unsigned char>(sum >> 2);
+            }
+        }
+    }
+}
+
+// Planar working layout (CPUMipMapOptions::planar_tiles), the CPU side of the gs_R, gs_G, gs_B and gs_A arrays
+// of GenerateMips_CS.hlsl: each channel of a tile in a plane of its own. The 2x2 box of a plane adds the byte
+// pairs of two rows whatever the channels of the image, with the same masks and shifts in every lane, and
+// the pixels are only split and put back together when the tile is read and each level stored.
+// floor((p0 + p1 + p2 + p3) / 4) of the bytes of row0 and row1, like boxReduce
+void boxPlaneRow(const unsigned char* row0, const unsigned char* row1, int dst_width, unsigned char* dst) {
+    int x = 0;
+#if defined(MIPGEN_AVX512)
+    // 32 destination bytes per iteration
+    const __m512i low_bytes512 = _mm512_set1_epi16(0x00FF);
+    for (; x + 32 <= dst_width; x += 32) {
+        const __m512i a = loadPixels512(row0 + 2 * x);
+        const __m512i b = loadPixels512(row1 + 2 * x);
+        const __m512i sum = _mm512_add_epi16(_mm512_add_epi16(_mm512_and_si512(a, low_bytes512), _mm512_srli_epi16(a, 8)),
+                                             _mm512_add_epi16(_mm512_and_si512(b, low_bytes512), _mm512_srli_epi16(b, 8)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm512_cvtepi16_epi8(_mm512_srli_epi16(sum, 2)));
+    }
+#endif
+#if defined(MIPGEN_AVX2)
+    // 32 destination bytes per iteration, packed per 128 bit lane and put back in order
+    const __m256i low_bytes256 = _mm256_set1_epi16(0x00FF);
+    for (; x + 32 <= dst_width; x += 32) {
+        __m256i sums[2];
+        for (int half = 0; half < 2; half++) {
+            const __m256i a = loadPixels256(row0 + 2 * x + 32 * half);
+            const __m256i b = loadPixels256(row1 + 2 * x + 32 * half);
+            sums[half] = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(_mm256_and_si256(a, low_bytes256), _mm256_srli_epi16(a, 8)),
+                                                            _mm256_add_epi16(_mm256_and_si256(b, low_bytes256), _mm256_srli_epi16(b, 8))), 2);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x),
+                            _mm256_permute4x64_epi64(_mm256_packus_epi16(sums[0], sums[1]), 0xD8));
+    }
+#endif
+#if defined(MIPGEN_SSE2)
+    // 16 destination bytes per iteration
+    const __m128i low_bytes = _mm_set1_epi16(0x00FF);
+    for (; x + 16 <= dst_width; x += 16) {
+        __m128i sums[2];
+        for (int half = 0; half < 2; half++) {
+            const __m128i a = loadPixels(row0 + 2 * x + 16 * half);
+            const __m128i b = loadPixels(row1 + 2 * x + 16 * half);
+            sums[half] = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_and_si128(a, low_bytes), _mm_srli_epi16(a, 8)),
+                                                      _mm_add_epi16(_mm_and_si128(b, low_bytes), _mm_srli_epi16(b, 8))), 2);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(sums[0], sums[1]));
+    }
+#endif
+#if defined(MIPGEN_NEON)
+    // 16 destination bytes per iteration, pairwise long adds
+    for (; x + 16 <= dst_width; x += 16) {
+        const uint16x8_t lo = vpadalq_u8(vpaddlq_u8(vld1q_u8(row0 + 2 * x)), vld1q_u8(row1 + 2 * x));
+        const uint16x8_t hi = vpadalq_u8(vpaddlq_u8(vld1q_u8(row0 + 2 * x + 16)), vld1q_u8(row1 + 2 * x + 16));
+        vst1q_u8(dst + x, vcombine_u8(vshrn_n_u16(lo, 2), vshrn_n_u16(hi, 2)));
+    }
+#endif
+    for (; x < dst_width; x++) {
+        dst[x] = static_cast<unsigned char>((row0[2 * x] + row0[2 * x + 1] + row1[2 * x] + row1[2 * x + 1]) >> 2);
+    }
+}
+
+#if defined(MIPGEN_AVX2)
+// Byte shuffles between 16 RGB pixels (3 vectors) and their planes, -1 zeroes the byte.
+// Channel channel of the pixels in vector part
+inline __m128i rgbToPlane(int channel, int part) {
+    alignas(16) signed char index[16];
+    for (int i = 0; i < 16; i++) {
+        const int byte = 3 * i + channel - 16 * part;
+        index[i] = static_cast<signed char>(byte >= 0 && byte < 16 ? byte : -1);
+    }
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(index));
+}
+
+// Bytes of vector part of the pixels taken from the plane of channel
+inline __m128i planeToRgb(int channel, int part) {
+    alignas(16) signed char index[16];
+    for (int i = 0; i < 16; i++) {
+        const int byte = 16 * part + i;
+        index[i] = static_cast<signed char>(byte % 3 == channel ? byte / 3 : -1);
+    }
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(index));
+}
+#endif
+
+// Splits pixels pixels of Channels channels in planes, channel c to planes + c * plane_size.
+// 16 pixels per iteration: the 128 bit loops of every x86 set (wider ones would only add lane fixes to a
+// pass that runs once per tile), RGB needs the byte shuffles of AVX2 CPUs. NEON loads the planes directly
+template <int Channels>
+void deinterleaveRow(const unsigned char* src, int pixels, unsigned char* planes, size_t plane_size) {
+    if (Channels == 1) {
+        std::memcpy(planes, src, pixels);
+        return;
+    }
+    int x = 0;
+#if defined(MIPGEN_AVX2)
+    if (Channels == 3) {
+        __m128i shuffles[3][3];
+        for (int c = 0; c < 3; c++) {
+            for (int part = 0; part < 3; part++) {
+                shuffles[c][part] = rgbToPlane(c, part);
+            }
+        }
+        for (; x + 16 <= pixels; x += 16) {
+            const __m128i parts[3] = { loadPixels(src + 3 * x), loadPixels(src + 3 * x + 16), loadPixels(src + 3 * x + 32) };
+            for (int c = 0; c < 3; c++) {
+                const __m128i plane = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(parts[0], shuffles[c][0]), _mm_shuffle_epi8(parts[1], shuffles[c][1])),
+                                                   _mm_shuffle_epi8(parts[2], shuffles[c][2]));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(planes + c * plane_size + x), plane);
+            }
+        }
+    }
+#endif
+#if defined(MIPGEN_SSE2)
+    // Even and odd bytes: the low and the high byte of each 16 bit lane
+    const __m128i low_bytes = _mm_set1_epi16(0x00FF);
+    auto evenBytes = [&](__m128i a, __m128i b) {
+        return _mm_packus_epi16(_mm_and_si128(a, low_bytes), _mm_and_si128(b, low_bytes));
+    };
+    auto oddBytes = [](__m128i a, __m128i b) {
+        return _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+    };
+    if (Channels == 2) {
+        for (; x + 16 <= pixels; x += 16) {
+            const __m128i a = loadPixels(src + 2 * x);
+            const __m128i b = loadPixels(src + 2 * x + 16);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(planes + x), evenBytes(a, b));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(planes + plane_size + x), oddBytes(a, b));
+        }
+    }
+    if (Channels == 4) {
+        for (; x + 16 <= pixels; x += 16) {
+            const __m128i p0 = loadPixels(src + 4 * x);
+            const __m128i p1 = loadPixels(src + 4 * x + 16);
+            const __m128i p2 = loadPixels(src + 4 * x + 32);
+            const __m128i p3 = loadPixels(src + 4 * x + 48);
+            // R and B, G and A alternating, then split again
+            const __m128i rb0 = evenBytes(p0, p1);
+            const __m128i rb1 = evenBytes(p2, p3);
+            const __m128i ga0 = oddBytes(p0, p1);
+            const __m128i ga1 = oddBytes(p2, p3);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(planes + x), evenBytes(rb0, rb1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(planes + plane_size + x), evenBytes(ga0, ga1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(planes + 2 * plane_size + x), oddBytes(rb0, rb1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(planes + 3 * plane_size + x), oddBytes(ga0, ga1));
+        }
+    }
+#endif
+#if defined(MIPGEN_NEON)
+    if (Channels == 2) {
+        for (; x + 16 <= pixels; x += 16) {
+            const uint8x16x2_t channels = vld2q_u8(src + 2 * x);
+            vst1q_u8(planes + x, channels.val[0]);
+            vst1q_u8(planes + plane_size + x, channels.val[1]);
+        }
+    }
+    if (Channels == 3) {
+        for (; x + 16 <= pixels; x += 16) {
+            const uint8x16x3_t channels = vld3q_u8(src + 3 * x);
+            for (int c = 0; c < 3; c++) {
+                vst1q_u8(planes + c * plane_size + x, channels.val[c]);
+            }
+        }
+    }
+    if (Channels == 4) {
+        for (; x + 16 <= pixels; x += 16) {
+            const uint8x16x4_t channels = vld4q_u8(src + 4 * x);
+            for (int c = 0; c < 4; c++) {
+                vst1q_u8(planes + c * plane_size + x, channels.val[c]);
+            }
+        }
+    }
+#endif
+    for (; x < pixels; x++) {
+        for (int c = 0; c < Channels; c++) {
+            planes[c * plane_size + x] = src[Channels * x + c];
+        }
+    }
+}
+
+// Puts pixels pixels of Channels channels back together from their planes, the inverse of deinterleaveRow
+template <int Channels>
+void interleaveRow(const unsigned char* planes, size_t plane_size, int pixels, unsigned char* dst) {
+    if (Channels == 1) {
+        std::memcpy(dst, planes, pixels);
+        return;
+    }
+    int x = 0;
+#if defined(MIPGEN_AVX2)
+    if (Channels == 3) {
+        __m128i shuffles[3][3];
+        for (int c = 0; c < 3; c++) {
+            for (int part = 0; part < 3; part++) {
+                shuffles[c][part] = planeToRgb(c, part);
+            }
+        }
+        for (; x + 16 <= pixels; x += 16) {
+            const __m128i channels[3] = { loadPixels(planes + x), loadPixels(planes + plane_size + x), loadPixels(planes + 2 * plane_size + x) };
+            for (int part = 0; part < 3; part++) {
+                const __m128i pixels16 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(channels[0], shuffles[0][part]), _mm_shuffle_epi8(channels[1], shuffles[1][part])),
+                                                      _mm_shuffle_epi8(channels[2], shuffles[2][part]));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * x + 16 * part), pixels16);
+            }
+        }
+    }
+#endif
+#if defined(MIPGEN_SSE2)
+    if (Channels == 2) {
+        for (; x + 16 <= pixels; x += 16) {
+            const __m128i c0 = loadPixels(planes + x);
+            const __m128i c1 = loadPixels(planes + plane_size + x);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * x), _mm_unpacklo_epi8(c0, c1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * x + 16), _mm_unpackhi_epi8(c0, c1));
+        }
+    }
+    if (Channels == 4) {
+        for (; x + 16 <= pixels; x += 16) {
+            const __m128i r = loadPixels(planes + x);
+            const __m128i g = loadPixels(planes + plane_size + x);
+            const __m128i b = loadPixels(planes + 2 * plane_size + x);
+            const __m128i a = loadPixels(planes + 3 * plane_size + x);
+            const __m128i rg0 = _mm_unpacklo_epi8(r, g);
+            const __m128i rg1 = _mm_unpackhi_epi8(r, g);
+            const __m128i ba0 = _mm_unpacklo_epi8(b, a);
+            const __m128i ba1 = _mm_unpackhi_epi8(b, a);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * x), _mm_unpacklo_epi16(rg0, ba0));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * x + 16), _mm_unpackhi_epi16(rg0, ba0));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * x + 32), _mm_unpacklo_epi16(rg1, ba1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * x + 48), _mm_unpackhi_epi16(rg1, ba1));
+        }
+    }
+#endif
+#if defined(MIPGEN_NEON)
+    if (Channels == 2) {
+        for (; x + 16 <= pixels; x += 16) {
+            vst2q_u8(dst + 2 * x, uint8x16x2_t{ { vld1q_u8(planes + x), vld1q_u8(planes + plane_size + x) } });
+        }
+    }
+    if (Channels == 3) {
+        for (; x + 16 <= pixels; x += 16) {
+            vst3q_u8(dst + 3 * x, uint8x16x3_t{ { vld1q_u8(planes + x), vld1q_u8(planes + plane_size + x),
+                                                  vld1q_u8(planes + 2 * plane_size + x) } });
+        }
+    }
+    if (Channels == 4) {
+        for (; x + 16 <= pixels; x += 16) {
+            vst4q_u8(dst + 4 * x, uint8x16x4_t{ { vld1q_u8(planes + x), vld1q_u8(planes + plane_size + x),
+                                                  vld1q_u8(planes + 2 * plane_size + x), vld1q_u8(planes + 3 * plane_size + x) } });
+        }
+    }
+#endif
+    for (; x < pixels; x++) {
+        for (int c = 0; c < Channels; c++) {
+            dst[Channels * x + c] = planes[c * plane_size + x];
+        }
+    }
+}
+
+// Rows of the pixels read and written for the columns [first_column, last_column) of dst_image
+struct Region {
+    const ImageView& src_image;
+    const ImageView& dst_image;
+    // Source pixels read by the horizontal filter
+    int src_column;
+    int src_columns;
+    int first_column;
+    int dst_width;
+
+    Region(const ImageView& src, const ImageView& dst, int first, int last)
+        : src_image(src), dst_image(dst), src_column(2 * first), src_columns(std::min(src.width - 2 * first, 2 * (last - first) + 1)),
+          first_column(first), dst_width(last - first) {
+    }
+    // First pixel of the region in row y of each image
+    const unsigned char* srcRow(int y) const {
+        return src_image.row(y) + static_cast<size_t>(src_column) * src_image.bytesPerPixel();
+    }
+    unsigned char* dstRow(int y) const {
+        return dst_image.row(y) + static_cast<size_t>(first_column) * dst_image.bytesPerPixel();
+    }
+};
+
+// GenerateMip.hlsl weights are separable: vertical pass then horizontal pass.
+// The coefficients are powers of two: fixed point, twice as many lanes as floats
+template <int Channels, int Columns, int Rows>
+void filterRegionFixed(const LevelKernel&, const ImageView& src_image, const ImageView& dst_image,
+                       int first_column, int last_column, int first_row, int last_row) {
+    const Region region(src_image, dst_image, first_column, last_column);
+    if (Columns == 2 && Rows == 2) {
+        // Every filter is the 2x2 box in this case (the weights only depend on the distance to the center)
+        boxReduce<Channels>(region.srcRow(2 * first_row), src_image.pitch, region.dstRow(first_row), dst_image.pitch,
+                            region.dst_width, last_row - first_row);
+        return;
+    }
+    // Leave room for the extra pixels the AVX2 loop may read at the end of the row
+    uint16_t* row_buffer = scratchRow<uint16_t>(static_cast<size_t>(region.src_columns) * Channels + 8);
+    for (int y = first_row; y < last_row; y++) {
+        // Rows of the neighbourhood in the src texture
+        const unsigned char* rows[Rows];
+        for (int j = 0; j < Rows; j++) {
+            rows[j] = region.srcRow(2 * y + j);
+        }
+        filterVerticalFixed<Rows>(rows, region.src_columns * Channels, row_buffer);
+        filterHorizontalFixed<Channels, Columns>(row_buffer, region.dst_width, region.dstRow(y));
+    }
+}
+
+template <int Channels, int Columns, int Rows>
+void filterRegionFixed16(const LevelKernel&, const ImageView& src_image, const ImageView& dst_image,
+                         int first_column, int last_column, int first_row, int last_row) {
+    const Region region(src_image, dst_image, first_column, last_column);
+    uint32_t* row_buffer = scratchRow<uint32_t>(static_cast<size_t>(region.src_columns) * Channels + 8);
+    for (int y = first_row; y < last_row; y++) {
+        const uint16_t* rows[Rows];
+        for (int j = 0; j < Rows; j++) {
+            rows[j] = reinterpret_cast<const uint16_t*>(region.srcRow(2 * y + j));
+        }
+        filterVerticalFixed16<Rows>(rows, region.src_columns * Channels, row_buffer);
+        filterHorizontalFixed16<Channels, Columns>(row_buffer, region.dst_width, reinterpret_cast<uint16_t*>(region.dstRow(y)));
+    }
+}
+
+// Same passes on the decoded values (HDR, linear, premultiplied or normals).
+// Channels are the floats of each decoded pixel (kernel.codec.channels)
+template <int Channels, int Columns, int Rows>
+void filterRegionSeparable(const LevelKernel& kernel, const ImageView& src_image, const ImageView& dst_image,
+                           int first_column, int last_column, int first_row, int last_row) {
+    const Region region(src_image, dst_image, first_column, last_column);
+    const size_t row_stride = static_cast<size_t>(region.src_columns) * Channels + 8;
+    float* row_buffer = scratchRow<float>(row_stride + region.dst_width * Channels);
+    float* filtered = row_buffer + row_stride;
+    for (int y = first_row; y < last_row; y++) {
+        const unsigned char* rows[Rows];
+        for (int j = 0; j < Rows; j++) {
+            rows[j] = region.srcRow(2 * y + j);
+        }
+        kernel.codec.decode[Rows - 1](rows, region.src_columns, row_buffer);
+        filterHorizontalFloat<Channels, Columns>(row_buffer, region.dst_width, filtered);
+        kernel.codec.encode(filtered, region.dst_width, region.dstRow(y));
+    }
+}
+
+// The MipFilters.hlsl weights come from the distance to the center, they are not separable.
+// Convert the rows of the neighbourhood to float and apply the whole 2D kernel. The sums are rounded to the
+// nearest value, like the float the shader writes to its UNORM target: the normalized weights do not sum
+// exactly 1, truncating would darken flat areas at every level
+template <int Channels, int Columns, int Rows>
+void filterRegionNeighbourhood(const LevelKernel& kernel, const ImageView& src_image, const ImageView& dst_image,
+                               int first_column, int last_column, int first_row, int last_row) {
+    const Region region(src_image, dst_image, first_column, last_column);
+    const size_t row_stride = static_cast<size_t>(region.src_columns) * Channels + 8;
+    float* row_buffers = scratchRow<float>(Rows * row_stride + region.dst_width * Channels);
+    float* filtered = row_buffers + Rows * row_stride;
+    for (int y = first_row; y < last_row; y++) {
+        const float* float_rows[Rows];
+        for (int j = 0; j < Rows; j++) {
+            const unsigned char* row = region.srcRow(2 * y + j);
+            kernel.codec.decode[0](&row, region.src_columns, row_buffers + j * row_stride);
+            float_rows[j] = row_buffers + j * row_stride;
+        }
+        filterNeighbourhood<Channels, Columns, Rows>(float_rows, *kernel.weights, region.dst_width, filtered);
+        kernel.codec.encode_nearest(filtered, region.dst_width, region.dstRow(y));
+    }
+}
+
+template <int Channels, int Columns, int Rows>
+RegionFilters regionFiltersOf() {
+    return { filterRegionFixed<Channels, Columns, Rows>, filterRegionFixed16<Channels, Columns, Rows>,
+             filterRegionSeparable<Channels, Columns, Rows>, filterRegionNeighbourhood<Channels, Columns, Rows> };
+}
+
+// [columns - 1][rows - 1]. A plain array: std::array would instantiate its (shared) members for every ISA
+struct NeighbourhoodFilters {
+    RegionFilters filters[3][3];
+};
+
+template <int Channels>
+NeighbourhoodFilters neighbourhoodFilters() {
+    return {{ { regionFiltersOf<Channels, 1, 1>(), regionFiltersOf<Channels, 1, 2>(), regionFiltersOf<Channels, 1, 3>() },
+              { regionFiltersOf<Channels, 2, 1>(), regionFiltersOf<Channels, 2, 2>(), regionFiltersOf<Channels, 2, 3>() },
+              { regionFiltersOf<Channels, 3, 1>(), regionFiltersOf<Channels, 3, 2>(), regionFiltersOf<Channels, 3, 3>() } }};
+}
+
+// Dispatch table of the region filters, by channels (1 to 4) and neighbourhood
+const RegionFilters& regionFilters(int channels, int columns, int rows) {
+    static const NeighbourhoodFilters filters[4] = {
+        neighbourhoodFilters<1>(), neighbourhoodFilters<2>(), neighbourhoodFilters<3>(), neighbourhoodFilters<4>()
+    };
+    return filters[channels - 1].filters[columns - 1][rows - 1];
+}
+
+// Vertical pass of the levels resampled from level 0, one decoded source row at a time
+void weightRow(const float* src, float weight, int count, bool accumulate, float* acc) {
+    int i = 0;
+#if defined(MIPGEN_AVX512)
+    const __m512 weight16 = _mm512_set1_ps(weight);
+    for (; i + 16 <= count; i += 16) {
+        const __m512 value = _mm512_mul_ps(weight16, _mm512_loadu_ps(src + i));
+        _mm512_storeu_ps(acc + i, accumulate ? _mm512_add_ps(_mm512_loadu_ps(acc + i), value) : value);
+    }
+#endif
+#if defined(MIPGEN_AVX2)
+    const __m256 weight8 = _mm256_set1_ps(weight);
+    for (; i + 8 <= count; i += 8) {
+        const __m256 value = _mm256_mul_ps(weight8, _mm256_loadu_ps(src + i));
+        _mm256_storeu_ps(acc + i, accumulate ? _mm256_add_ps(_mm256_loadu_ps(acc + i), value) : value);
+    }
+#endif
+#if defined(MIPGEN_SSE2)
+    const __m128 weight4 = _mm_set1_ps(weight);
+    for (; i + 4 <= count; i += 4) {
+        const __m128 value = _mm_mul_ps(weight4, _mm_loadu_ps(src + i));
+        _mm_storeu_ps(acc + i, accumulate ? _mm_add_ps(_mm_loadu_ps(acc + i), value) : value);
+    }
+#endif
+#if defined(MIPGEN_NEON)
+    for (; i + 4 <= count; i += 4) {
+        const float32x4_t value = vmulq_n_f32(vld1q_f32(src + i), weight);
+        vst1q_f32(acc + i, accumulate ? vaddq_f32(vld1q_f32(acc + i), value) : value);
+    }
+#endif
+    for (; i < count; i++) {
+        acc[i] = accumulate ? acc[i] + weight * src[i] : weight * src[i];
+    }
+}
+
+// Horizontal pass of the resampler, see AxisWeights. The taps of a pixel are summed in 4 float lanes, each
+// holding one channel of every (4 / Channels)-th tap, and the lanes are added at the end: the same order in
+// every set, so they write the same bytes. RGB pixels do not fit in the lanes and sum one tap at a time
+template <int Channels>
+void resampleRow(const float* src, int src_offset, const int* first, const float* weights, int taps, int count, float* dst) {
+    for (int x = 0; x < count; x++) {
+        const float* pixels = src + (first[x] - src_offset) * Channels;
+        const float* pixel_weights = weights + static_cast<size_t>(x) * taps;
+        if (Channels == 3) {
+            float sum[3] = {};
+            for (int k = 0; k < taps; k++) {
+                for (int c = 0; c < 3; c++) {
+                    sum[c] += pixel_weights[k] * pixels[k * 3 + c];
+                }
+            }
+            for (int c = 0; c < 3; c++) {
+                dst[x * 3 + c] = sum[c];
+            }
+            continue;
+        }
+        // Taps per 4 lanes
+        const int lane_taps = 4 / Channels;
+        int k = 0;
+        alignas(16) float lanes[4] = {};
+#if defined(MIPGEN_SSE2)
+        __m128 sum = _mm_setzero_ps();
+        for (; k + lane_taps <= taps; k += lane_taps) {
+            __m128 weight;
+            if (Channels == 1) {
+                weight = _mm_loadu_ps(pixel_weights + k);
+            } else if (Channels == 2) {
+                weight = _mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pixel_weights + k)));
+                weight = _mm_unpacklo_ps(weight, weight);
+            } else {
+                weight = _mm_set1_ps(pixel_weights[k]);
+            }
+            sum = _mm_add_ps(sum, _mm_mul_ps(weight, _mm_loadu_ps(pixels + k * Channels)));
+        }
+        _mm_store_ps(lanes, sum);
+#elif defined(MIPGEN_NEON)
+        float32x4_t sum = vdupq_n_f32(0.0f);
+        for (; k + lane_taps <= taps; k += lane_taps) {
+            float32x4_t weight;
+            if (Channels == 1) {
+                weight = vld1q_f32(pixel_weights + k);
+            } else if (Channels == 2) {
+                weight = vcombine_f32(vdup_n_f32(pixel_weights[k]), vdup_n_f32(pixel_weights[k + 1]));
+            } else {
+                weight = vdupq_n_f32(pixel_weights[k]);
+            }
+            sum = vaddq_f32(sum, vmulq_f32(weight, vld1q_f32(pixels + k * Channels)));
+        }
+        vst1q_f32(lanes, sum);
+#endif
+        for (; k + lane_taps <= taps; k += lane_taps) {
+            for (int i = 0; i < 4; i++) {
+                lanes[i] += pixel_weights[k + i / Channels] * pixels[k * Channels + i];
+            }
+        }
+        // The last taps go to the lanes they would have been in
+        for (int i = 0; k + i / Channels < taps; i++) {
+            lanes[i] += pixel_weights[k + i / Channels] * pixels[k * Channels + i];
+        }
+        if (Channels == 1) {
+            dst[x] = (lanes[0] + lanes[2]) + (lanes[1] + lanes[3]);
+        } else if (Channels == 2) {
+            dst[x * 2] = lanes[0] + lanes[2];
+            dst[x * 2 + 1] = lanes[1] + lanes[3];
+        } else {
+            for (int c = 0; c < 4; c++) {
+                dst[x * 4 + c] = lanes[c];
+            }
+        }
+    }
+}
+
+// Filters.hlsl blur or sharpen of a row of decoded pixels, see MipKernels::post_filter_row.
+// Every float is the sum of its 9 taps, row by row: the taps of a pixel are the floats one pixel apart
+template <int Channels>
+void postFilterRow(const float* const* rows, const FilterKernel& weights, int pixels, float* dst) {
+    const int alpha = alphaChannel(Channels);
+    const int count = pixels * Channels;
+    int i = 0;
+#if defined(MIPGEN_AVX512)
+    for (; i + 16 <= count; i += 16) {
+        __m512 sum = _mm512_setzero_ps();
+        for (int j = 0; j < 3; j++) {
+            for (int t = 0; t < 3; t++) {
+                sum = _mm512_add_ps(sum, _mm512_mul_ps(_mm512_set1_ps(weights.weights[j][t]), _mm512_loadu_ps(rows[j] + i + t * Channels)));
+            }
+        }
+        _mm512_storeu_ps(dst + i, sum);
+    }
+#endif
+#if defined(MIPGEN_AVX2)
+    for (; i + 8 <= count; i += 8) {
+        __m256 sum = _mm256_setzero_ps();
+        for (int j = 0; j < 3; j++) {
+            for (int t = 0; t < 3; t++) {
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights.weights[j][t]), _mm256_loadu_ps(rows[j] + i + t * Channels)));
+            }
+        }
+        _mm256_storeu_ps(dst + i, sum);
+    }
+#endif
+#if defined(MIPGEN_SSE2)
+    for (; i + 4 <= count; i += 4) {
+        __m128 sum = _mm_setzero_ps();
+        for (int j = 0; j < 3; j++) {
+            for (int t = 0; t < 3; t++) {
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights.weights[j][t]), _mm_loadu_ps(rows[j] + i + t * Channels)));
+            }
+        }
+        _mm_storeu_ps(dst + i, sum);
+    }
+#endif
+#if defined(MIPGEN_NEON)
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t sum = vdupq_n_f32(0.0f);
+        for (int j = 0; j < 3; j++) {
+            for (int t = 0; t < 3; t++) {
+                sum = vaddq_f32(sum, vmulq_n_f32(vld1q_f32(rows[j] + i + t * Channels), weights.weights[j][t]));
+            }
+        }
+        vst1q_f32(dst + i, sum);
+    }
+#endif
+    for (; i < count; i++) {
+        float sum = 0.0f;
+        for (int j = 0; j < 3; j++) {
+            for (int t = 0; t < 3; t++) {
+                sum += weights.weights[j][t] * rows[j][i + t * Channels];
+            }
+        }
+        dst[i] = sum;
+    }
+    // Filters.hlsl only filters the color
+    if (alpha >= 0) {
+        for (int x = 0; x < pixels; x++) {
+            dst[x * Channels + alpha] = rows[1][(x + 1) * Channels + alpha];
+        }
+    }
+}
+
+// Color transform of a row of filtered values, in place (see pixelColorTransform). Each channel is
+// matrix[c][0] * in[0] + matrix[c][1] * in[1] + ... + offset[c], in that order in every set
+template <int Channels>
+void colorRow(const ColorTransform& transform, int pixels, float* values) {
+    int x = 0;
+#if defined(MIPGEN_SSE2)
+    if (Channels == 4) {
+        __m128 columns[4];
+        for (int i = 0; i < 4; i++) {
+            columns[i] = _mm_setr_ps(transform.matrix[0][i], transform.matrix[1][i], transform.matrix[2][i], transform.matrix[3][i]);
+        }
+        const __m128 offset = _mm_loadu_ps(transform.offset);
+        for (; x < pixels; x++) {
+            const __m128 pixel = _mm_loadu_ps(values + 4 * x);
+            __m128 out = _mm_mul_ps(columns[0], _mm_shuffle_ps(pixel, pixel, _MM_SHUFFLE(0, 0, 0, 0)));
+            out = _mm_add_ps(out, _mm_mul_ps(columns[1], _mm_shuffle_ps(pixel, pixel, _MM_SHUFFLE(1, 1, 1, 1))));
+            out = _mm_add_ps(out, _mm_mul_ps(columns[2], _mm_shuffle_ps(pixel, pixel, _MM_SHUFFLE(2, 2, 2, 2))));
+            out = _mm_add_ps(out, _mm_mul_ps(columns[3], _mm_shuffle_ps(pixel, pixel, _MM_SHUFFLE(3, 3, 3, 3))));
+            _mm_storeu_ps(values + 4 * x, _mm_add_ps(out, offset));
+        }
+    }
+#endif
+#if defined(MIPGEN_NEON)
+    if (Channels == 4) {
+        float32x4_t columns[4];
+        for (int i = 0; i < 4; i++) {
+            const float column[4] = { transform.matrix[0][i], transform.matrix[1][i], transform.matrix[2][i], transform.matrix[3][i] };
+            columns[i] = vld1q_f32(column);
+        }
+        const float32x4_t offset = vld1q_f32(transform.offset);
+        for (; x < pixels; x++) {
+            const float32x4_t pixel = vld1q_f32(values + 4 * x);
+            float32x4_t out = vmulq_n_f32(columns[0], vgetq_lane_f32(pixel, 0));
+            out = vaddq_f32(out, vmulq_n_f32(columns[1], vgetq_lane_f32(pixel, 1)));
+            out = vaddq_f32(out, vmulq_n_f32(columns[2], vgetq_lane_f32(pixel, 2)));
+            out = vaddq_f32(out, vmulq_n_f32(columns[3], vgetq_lane_f32(pixel, 3)));
+            vst1q_f32(values + 4 * x, vaddq_f32(out, offset));
+        }
+    }
+#endif
+    for (; x < pixels; x++) {
+        float* pixel = values + Channels * x;
+        float in[Channels];
+        for (int i = 0; i < Channels; i++) {
+            in[i] = pixel[i];
+        }
+        for (int c = 0; c < Channels; c++) {
+            float value = transform.matrix[c][0] * in[0];
+            for (int i = 1; i < Channels; i++) {
+                value += transform.matrix[c][i] * in[i];
+            }
+            pixel[c] = value + transform.offset[c];
+        }
+    }
+}
+
+// Entry points of the kernels built by the including file
+MipKernels kernelsNamed(const char* name) {
+    return { name, regionFilters, rowCodec, weightRow,
+             { resampleRow<1>, resampleRow<2>, resampleRow<3>, resampleRow<4> },
+             { postFilterRow<1>, postFilterRow<2>, postFilterRow<3>, postFilterRow<4> },
+             { colorRow<1>, colorRow<2>, colorRow<3>, colorRow<4> },
+             { deinterleaveRow<1>, deinterleaveRow<2>, deinterleaveRow<3>, deinterleaveRow<4> },
+             { interleaveRow<1>, interleaveRow<2>, interleaveRow<3>, interleaveRow<4> }, boxPlaneRow };
+}
+
+} // namespace
@@ -0,0 +1,36 @@
+#include "CPUMipMapKernels.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+// Only this file targets AVX2, the rest of the program runs on any x86 CPU. MSVC compiles the intrinsics
+// without /arch:AVX2, which would also let it use AVX2 in the standard library code instantiated here
+// and shared with the other files
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,f16c"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2,f16c")
+#endif
+
+// Every AVX2 CPU has F16C too
+#define MIPGEN_SSE2
+#define MIPGEN_AVX2
+#define MIPGEN_F16C
+#include "CPUMipMapKernels.inl"
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+const MipKernels* avx2Kernels() {
+    static const MipKernels kernels = kernelsNamed("avx2");
+    return &kernels;
+}
+#else
+const MipKernels* avx2Kernels() {
+    return nullptr;
+}
+#endif
@@ -0,0 +1,43 @@
+#include "CPUMipMapKernels.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+// GCC reports '__Y' may be used uninitialized inside its own AVX-512 headers wherever the kernels inline
+// them (the undefined vectors of their masked intrinsics), a known false positive. The warning is given at the
+// lines of the headers, so it is turned off from their include to the end of the kernels
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <immintrin.h>
+
+// AVX-512 F and BW widen the integer and float filters, the rest of the loops are the AVX2 ones.
+// Like CPUMipMapKernelsAVX2.cpp, MSVC builds it without /arch
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f,avx512bw,avx2,f16c"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw,avx2,f16c")
+#endif
+
+#define MIPGEN_SSE2
+#define MIPGEN_AVX2
+#define MIPGEN_F16C
+#define MIPGEN_AVX512
+#include "CPUMipMapKernels.inl"
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#pragma GCC diagnostic pop
+#endif
+
+const MipKernels* avx512Kernels() {
+    static const MipKernels kernels = kernelsNamed("avx512");
+    return &kernels;
+}
+#else
+const MipKernels* avx512Kernels() {
+    return nullptr;
+}
+#endif
@@ -0,0 +1,18 @@
+#include "CPUMipMapKernels.h"
+
+// Always there on ARM64. 32 bit ARM builds have it when they target it (-mfpu=neon)
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+
+#define MIPGEN_NEON
+#include "CPUMipMapKernels.inl"
+
+const MipKernels* neonKernels() {
+    static const MipKernels kernels = kernelsNamed("neon");
+    return &kernels;
+}
+#else
+const MipKernels* neonKernels() {
+    return nullptr;
+}
+#endif
@@ -0,0 +1,31 @@
+#include "CPUMipMapKernels.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+
+// Part of x86-64, 32 bit builds may not target it
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("sse2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#endif
+
+#define MIPGEN_SSE2
+#include "CPUMipMapKernels.inl"
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+const MipKernels* sse2Kernels() {
+    static const MipKernels kernels = kernelsNamed("sse2");
+    return &kernels;
+}
+#else
+const MipKernels* sse2Kernels() {
+    return nullptr;
+}
+#endif
@@ -0,0 +1,9 @@
+#include "CPUMipMapKernels.h"
+
+// Plain C++ kernels, for CPUs without any of the SIMD sets (and to compare the others with)
+#include "CPUMipMapKernels.inl"
+
+const MipKernels* scalarKernels() {
+    static const MipKernels kernels = kernelsNamed("scalar");
+    return &kernels;
+}
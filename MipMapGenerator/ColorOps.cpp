@@ -0,0 +1,124 @@
+#include "ColorOps.h"
+
+namespace {
+
+ColorTransform identityTransform() {
+    ColorTransform transform{};
+    for (int c = 0; c < 4; c++) {
+        transform.matrix[c][c] = 1.0f;
+    }
+    return transform;
+}
+
+ColorTransform opTransform(const ColorOp& op) {
+    ColorTransform transform = identityTransform();
+    switch (op.type) {
+    case ColorOpType::Desaturate: {
+        const float weights[3] = { 0.3f, 0.59f, 0.11f };
+        for (int c = 0; c < 3; c++) {
+            for (int i = 0; i < 3; i++) {
+                transform.matrix[c][i] = weights[i];
+            }
+        }
+        break;
+    }
+    case ColorOpType::Tint:
+        for (int c = 0; c < 4; c++) {
+            transform.matrix[c][c] = op.factors[c];
+        }
+        break;
+    case ColorOpType::Swizzle:
+        for (int c = 0; c < 4; c++) {
+            transform.matrix[c][c] = 0.0f;
+            if (op.sources[c] < 4) {
+                transform.matrix[c][op.sources[c]] = 1.0f;
+            } else {
+                transform.offset[c] = op.sources[c] == 5 ? 1.0f : 0.0f;
+            }
+        }
+        break;
+    }
+    return transform;
+}
+
+// second(first(x))
+ColorTransform compose(const ColorTransform& first, const ColorTransform& second) {
+    ColorTransform transform{};
+    for (int c = 0; c < 4; c++) {
+        transform.offset[c] = second.offset[c];
+        for (int k = 0; k < 4; k++) {
+            transform.offset[c] += second.matrix[c][k] * first.offset[k];
+            for (int i = 0; i < 4; i++) {
+                transform.matrix[c][i] += second.matrix[c][k] * first.matrix[k][i];
+            }
+        }
+    }
+    return transform;
+}
+
+} // namespace
+
+ColorOp desaturateOp() {
+    return { ColorOpType::Desaturate, {}, {} };
+}
+
+ColorOp tintOp(float r, float g, float b, float a) {
+    return { ColorOpType::Tint, { r, g, b, a }, {} };
+}
+
+bool swizzleOp(const std::string& swizzle, ColorOp& op) {
+    const std::string sources{ "rgba01" };
+    if (swizzle.size() != 4) {
+        return false;
+    }
+    op = { ColorOpType::Swizzle, {}, {} };
+    for (int c = 0; c < 4; c++) {
+        const size_t source = sources.find(swizzle[c]);
+        if (source == std::string::npos) {
+            return false;
+        }
+        op.sources[c] = static_cast<int>(source);
+    }
+    return true;
+}
+
+ColorTransform composeColorOps(const std::vector<ColorOp>& ops) {
+    ColorTransform transform = identityTransform();
+    for (const ColorOp& op : ops) {
+        transform = compose(transform, opTransform(op));
+    }
+    return transform;
+}
+
+bool isIdentity(const ColorTransform& transform) {
+    for (int c = 0; c < 4; c++) {
+        for (int i = 0; i < 4; i++) {
+            if (transform.matrix[c][i] != (c == i ? 1.0f : 0.0f)) {
+                return false;
+            }
+        }
+        if (transform.offset[c] != 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+ColorTransform pixelColorTransform(const ColorTransform& transform, int channels, float max_value) {
+    // RGBA channel of each channel of the pixels, -1 for those they do not have
+    const int grey_channels[4] = { 0, -1, -1, -1 };
+    const int grey_alpha_channels[4] = { 0, 3, -1, -1 };
+    const int color_channels[4] = { 0, 1, 2, 3 };
+    const int* rgba = channels == 1 ? grey_channels : (channels == 2 ? grey_alpha_channels : color_channels);
+    const bool grey = channels <= 2;
+    const bool alpha = channels == 2 || channels == 4;
+    ColorTransform pixel{};
+    for (int c = 0; c < channels; c++) {
+        const float* row = transform.matrix[rgba[c]];
+        pixel.offset[c] = transform.offset[rgba[c]] * max_value + (alpha ? 0.0f : row[3] * max_value);
+        for (int i = 0; i < channels; i++) {
+            pixel.matrix[c][i] = (grey && rgba[i] == 0) ? row[0] + row[1] + row[2] : row[rgba[i]];
+        }
+    }
+    return pixel;
+}
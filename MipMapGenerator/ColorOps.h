@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Per pixel color transforms, the CPU version of Desaturate.hlsl and friends.
+// All of them are affine, so any sequence of them is a single 4x4 matrix and offset: the CPU generator
+// applies it once, to the straight alpha pixels of level 0 (CPUMipMapGenerator::transformColors), whatever the
+// number of operations, and every level is reduced from the transformed one
+enum class ColorOpType : int {
+    // Grey (R * 0.3 + G * 0.59 + B * 0.11, the weights of Desaturate.hlsl) in R, G and B
+    Desaturate = 0,
+    // Every channel multiplied by its factor
+    Tint,
+    // Every channel taken from another one, or set to 0 or 1
+    Swizzle
+};
+
+struct ColorOp {
+    ColorOpType type;
+    // Tint: factors of R, G, B and A
+    float factors[4];
+    // Swizzle: source of R, G, B and A: 0 to 3 (R, G, B or A), 4 (0) or 5 (1)
+    int sources[4];
+};
+
+// out[c] = sum(matrix[c][i] * in[i]) + offset[c], on RGBA values in [0, 1]
+struct ColorTransform {
+    float matrix[4][4];
+    float offset[4];
+};
+
+ColorOp desaturateOp();
+ColorOp tintOp(float r, float g, float b, float a = 1.0f);
+// Four of r, g, b, a, 0 and 1, i. e. "bgra" or "rrr1". Returns false if swizzle is not valid
+bool swizzleOp(const std::string& swizzle, ColorOp& op);
+// The transform of ops applied in order. No ops is the identity
+ColorTransform composeColorOps(const std::vector<ColorOp>& ops);
+bool isIdentity(const ColorTransform& transform);
+// transform of the channels of pixels with channels channels and values in [0, max_value] (i. e. 255 for 8 bit
+// ones): matrix[c][i] and offset[c] for c and i below channels. Grey (1 channel) and grey + alpha pixels are
+// (grey, grey, grey) for the transform and take its R back. Pixels without alpha are opaque
+ColorTransform pixelColorTransform(const ColorTransform& transform, int channels, float max_value);
@@ -22,14 +22,14 @@ StructuredBuffer<Pixel> Buffer0 : register(t0); // Source texture
 RWStructuredBuffer<Pixel> BufferOut : register(u0); // Destination texture
 
 // Helper functions to fetch/write values into the textures
-void writeToPixel(int x, int y, float3 colour);
-float3 readPixel(int x, int y);
+void writeToPixel(int x, int y, float4 colour);
+float4 readPixel(int x, int y);
 
 // According to the dimensions of the src texture we can be in one of four cases
-float3 computePixelEvenEven(int2 scrCoords);
-float3 computePixelEvenOdd(int2 srcCoords);
-float3 computePixelOddEven(int2 srcCoords);
-float3 computePixelOddOdd(int2 srcCoords);
+float4 computePixelEvenEven(int2 scrCoords);
+float4 computePixelEvenOdd(int2 srcCoords);
+float4 computePixelOddEven(int2 srcCoords);
+float4 computePixelOddOdd(int2 srcCoords);
 
 [numthreads(1, 1, 1)]
 void CSMain(uint3 dispatchThreadID : SV_DispatchThreadID)
@@ -37,7 +37,7 @@ void CSMain(uint3 dispatchThreadID : SV_DispatchThreadID)
 	// Calculate the coordinates of the top left corner of the neighbourhood
 	int2 coordInSrc = 2 * dispatchThreadID.xy;
 	
-	float3 resultingPixel = float3(0.0f, 0.0f, 0.0f);
+	float4 resultingPixel = float4(0.0f, 0.0f, 0.0f, 0.0f);
 	// Get the filtered value from the src texture's neighbourhood
 	// Choose the correct case according to src texture dimensions
 	switch (dimension_case) {
@@ -61,8 +61,8 @@ void CSMain(uint3 dispatchThreadID : SV_DispatchThreadID)
 
 // In this case both dimensions (width and height) are even
 // srcCoor are the coordinates of the top left corner of the neighbourhood in the src texture
-float3 computePixelEvenEven(int2 srcCoords) {	
-	float3 resultPixel = float3(0.0f, 0.0f, 0.0f);
+float4 computePixelEvenEven(int2 srcCoords) {	
+	float4 resultPixel = float4(0.0f, 0.0f, 0.0f, 0.0f);
 	//We will need a 2x2 neighbourhood sampling
 	const int2 neighbours[2][2] = {
 		{ {srcCoords.x, srcCoords.y    }, {srcCoords.x + 1, srcCoords.y    } },
@@ -85,8 +85,8 @@ float3 computePixelEvenEven(int2 srcCoords) {
 // In this case width is even and height is odd
 // srcCoor are the coordinates of the top left corner of the neighbourhood in the src texture
 // This neighbourhood has size 2x3 (in math matices notation)
-float3 computePixelEvenOdd(int2 srcCoords) {
-	float3 resultPixel = float3(0.0f, 0.0f, 0.0f);
+float4 computePixelEvenOdd(int2 srcCoords) {
+	float4 resultPixel = float4(0.0f, 0.0f, 0.0f, 0.0f);
 	//We will need a 2x3 neighbourhood sampling
 	const int2 neighbours[2][3] = {
 		{ {srcCoords.x, srcCoords.y    }, {srcCoords.x + 1, srcCoords.y    }, {srcCoords.x + 2, srcCoords.y    } },
@@ -109,8 +109,8 @@ float3 computePixelEvenOdd(int2 srcCoords) {
 // In this case width is odd and height is even
 // srcCoor are the coordinates of the top left corner of the neighbourhood in the src texture
 // This neighbourhood has size 3x2 (in math matices notation)
-float3 computePixelOddEven(int2 srcCoords) {
-	float3 resultPixel = float3(0.0f, 0.0f, 0.0f);
+float4 computePixelOddEven(int2 srcCoords) {
+	float4 resultPixel = float4(0.0f, 0.0f, 0.0f, 0.0f);
 	//We will need a 3x2 neighbourhood sampling
 	const int2 neighbours[3][2] = {
 		{ {srcCoords.x, srcCoords.y    }, {srcCoords.x + 1, srcCoords.y    } },
@@ -135,8 +135,8 @@ float3 computePixelOddEven(int2 srcCoords) {
 // In this case both width and height are odd
 // srcCoor are the coordinates of the higher left corner of the neighbourhood in the src texture
 // This neighbourhood has size 3x3 (in math matices notation)
-float3 computePixelOddOdd(int2 srcCoords) {
-	float3 resultPixel = float3(0.0f, 0.0f, 0.0f);
+float4 computePixelOddOdd(int2 srcCoords) {
+	float4 resultPixel = float4(0.0f, 0.0f, 0.0f, 0.0f);
 	//We will need a 3x3 neighbourhood sampling
 	const int2 neighbours[3][3] = {
 		{ {srcCoords.x, srcCoords.y    }, {srcCoords.x + 1, srcCoords.y    }, {srcCoords.x + 2, srcCoords.y    } },
@@ -160,7 +160,7 @@ float3 computePixelOddOdd(int2 srcCoords) {
 // Write the colour to the destitantion texture at pixle coordinates (x,y)
 // in order to work propartlly x must be in [0, dst_width) and y in [0, dst_height]
 // otherwise a different pixel might be written
-void writeToPixel(int x, int y, float3 colour) {
+void writeToPixel(int x, int y, float4 colour) {
 	// Since image is flattened, we need to recover the corresponding index
 	uint index = (x + y * dst_width);
 	// The pixels are encoded a an unsigned 32 bit integer
@@ -169,15 +169,16 @@ void writeToPixel(int x, int y, float3 colour) {
 	int ired =   (int)(clamp(colour.r, 0.0f, 1.0f) * 255);
 	int igreen = (int)(clamp(colour.g, 0.0f, 1.0f) * 255) << 8;
 	int iblue =  (int)(clamp(colour.b, 0.0f, 1.0f) * 255) << 16;
+	int ialpha = (int)(clamp(colour.a, 0.0f, 1.0f) * 255) << 24;
 	// Write to destination texture
-	BufferOut[index].colour = ired + igreen + iblue;
+	BufferOut[index].colour = ired + igreen + iblue + ialpha;
 }
 
 // Read a colour from the source texture at pixle coordinates (x,y)
 // in order to work propartlly x must be in [0, src_width) and y in [0, src_height]
 // otherwise a different pixel might be returned
-float3 readPixel(int x, int y) {
-	float3 output;
+float4 readPixel(int x, int y) {
+	float4 output;
 	// Since image is flattened, we need to recover the corresponding index
 	uint index = (x + y * src_width);
 	// The pixels are encoded a an unsigned 32 bit integer
@@ -186,6 +187,7 @@ float3 readPixel(int x, int y) {
 	output.x = (float)(((Buffer0[index].colour) & 0x000000ff)      ) / 255.0f;
 	output.y = (float)(((Buffer0[index].colour) & 0x0000ff00) >>  8) / 255.0f;
 	output.z = (float)(((Buffer0[index].colour) & 0x00ff0000) >> 16) / 255.0f;
+	output.w = (float)(((Buffer0[index].colour) >> 24) & 0x000000ff) / 255.0f;
 
 	return output;
 }
@@ -0,0 +1,87 @@
+#include <cstring>
+
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#include <immintrin.h>
+#define MIPGEN_F16C
+#endif
+
+#include "HalfFloat.h"
+
+namespace {
+
+uint32_t floatBits(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+float bitsFloat(uint32_t bits) {
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+} // namespace
+
+float halfToFloat(uint16_t half) {
+    const uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1F;
+    const uint32_t mantissa = half & 0x3FF;
+    if (exponent == 0x1F) {
+        // Infinity or NaN (quiet, like vcvtph2ps)
+        return bitsFloat(sign | 0x7F800000 | (mantissa << 13) | (mantissa != 0 ? 0x400000 : 0));
+    }
+    if (exponent == 0) {
+        // Zero or denormal: mantissa * 2^-24, exact in a float
+        return bitsFloat(sign | floatBits(static_cast<float>(mantissa) * (1.0f / 16777216.0f)));
+    }
+    return bitsFloat(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+uint16_t floatToHalf(float value) {
+    uint32_t bits = floatBits(value);
+    const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    bits &= 0x7FFFFFFF;
+    if (bits > 0x7F800000) {
+        // NaN: quiet, with the top of the payload (like vcvtps2ph)
+        return sign | 0x7E00 | static_cast<uint16_t>((bits >> 13) & 0x3FF);
+    }
+    if (bits >= 0x47800000) {
+        // 65536 and above (infinity included). Values in [65520, 65536) round up to infinity below
+        return sign | 0x7C00;
+    }
+    if (bits < 0x38800000) {
+        // Below 2^-14 the result is denormal (or zero): adding 0.5 aligns the half mantissa with the
+        // low bits of the float one, and the float addition does the rounding to nearest even
+        const uint32_t magic = 126u << 23;
+        return sign | static_cast<uint16_t>(floatBits(bitsFloat(bits) + bitsFloat(magic)) - magic);
+    }
+    // Rebias the exponent and round the 13 bits we drop to nearest even
+    const uint32_t odd = (bits >> 13) & 1;
+    bits += (static_cast<uint32_t>(15 - 127) << 23) + 0xFFF + odd;
+    return sign | static_cast<uint16_t>(bits >> 13);
+}
+
+void halfToFloatRow(const uint16_t* src, size_t count, float* dst) {
+    size_t i = 0;
+#if defined(MIPGEN_F16C)
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))));
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = halfToFloat(src[i]);
+    }
+}
+
+void floatToHalfRow(const float* src, size_t count, uint16_t* dst) {
+    size_t i = 0;
+#if defined(MIPGEN_F16C)
+    for (; i + 8 <= count; i += 8) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = floatToHalf(src[i]);
+    }
+}
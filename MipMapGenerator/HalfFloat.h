@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// IEEE 754 half precision floats (DXGI_FORMAT_R16G16B16A16_FLOAT), the storage of HDR images.
+// Conversions round to the nearest even value, the same results than the F16C instructions
+// (out of range values become infinities, NaNs stay NaNs)
+
+float halfToFloat(uint16_t half);
+uint16_t floatToHalf(float value);
+// count values of a row, with F16C when the compiler targets it
+void halfToFloatRow(const uint16_t* src, size_t count, float* dst);
+void floatToHalfRow(const float* src, size_t count, uint16_t* dst);
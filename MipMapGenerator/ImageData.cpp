@@ -1,36 +1,259 @@
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <new>
 #include <stdexcept>
+#include <vector>
 
+#include "BufferPool.h"
+
+namespace {
+
+// stb_image decodes into blocks of the pool too: its buffers and the pixels it returns are recycled.
+// It expects null when there is no memory left
+void* stbiMalloc(size_t bytes) {
+    try {
+        return BufferPool::instance().allocate(bytes);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* stbiRealloc(void* block, size_t bytes) {
+    try {
+        return BufferPool::instance().reallocate(static_cast<unsigned char*>(block), bytes);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void stbiFree(void* block) {
+    BufferPool::instance().release(static_cast<unsigned char*>(block));
+}
+
+} // namespace
+
+#define STBI_MALLOC(size) stbiMalloc(size)
+#define STBI_REALLOC(block, size) stbiRealloc(static_cast<void*>(block), size)
+#define STBI_FREE(block) stbiFree(static_cast<void*>(block))
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb_image_write.h>
 
 
+#include "HalfFloat.h"
 #include "ImageData.h"
+#include "ImageView.h"
+
+namespace {
+
+uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc) {
+    static const std::vector<uint32_t> table = [] {
+        std::vector<uint32_t> values(256);
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            values[n] = c;
+        }
+        return values;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+void appendBigEndian(std::vector<unsigned char>& out, uint32_t value) {
+    out.push_back(static_cast<unsigned char>(value >> 24));
+    out.push_back(static_cast<unsigned char>(value >> 16));
+    out.push_back(static_cast<unsigned char>(value >> 8));
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+// Length, type, data and CRC (of the type and the data)
+void appendPngChunk(std::vector<unsigned char>& png, const char* type, const unsigned char* data, size_t size) {
+    appendBigEndian(png, static_cast<uint32_t>(size));
+    const size_t start = png.size();
+    png.insert(png.end(), type, type + 4);
+    png.insert(png.end(), data, data + size);
+    appendBigEndian(png, crc32(png.data() + start, size + 4, 0));
+}
+
+// stb_image_write only writes 8 bit PNGs, 16 bit ones are put together here with its zlib compressor.
+// Every row uses the Sub filter (difference with the previous pixel), which suits smooth data like heightmaps
+bool writePng16(const std::string& filename, int width, int height, int channels, const uint16_t* pixels) {
+    const size_t row_values = static_cast<size_t>(width) * channels;
+    const size_t pixel_bytes = static_cast<size_t>(channels) * 2;
+    std::vector<unsigned char> rows;
+    rows.reserve((2 * row_values + 1) * height);
+    std::vector<unsigned char> row(2 * row_values);
+    for (int y = 0; y < height; y++) {
+        // Samples are big endian
+        for (size_t i = 0; i < row_values; i++) {
+            const uint16_t value = pixels[y * row_values + i];
+            row[2 * i] = static_cast<unsigned char>(value >> 8);
+            row[2 * i + 1] = static_cast<unsigned char>(value);
+        }
+        rows.push_back(1);
+        for (size_t i = 0; i < row.size(); i++) {
+            rows.push_back(static_cast<unsigned char>(row[i] - (i >= pixel_bytes ? row[i - pixel_bytes] : 0)));
+        }
+    }
+    int compressed_size = 0;
+    unsigned char* compressed = stbi_zlib_compress(rows.data(), static_cast<int>(rows.size()), &compressed_size, 8);
+    if (!compressed) {
+        return false;
+    }
+    // Grey, grey + alpha, RGB and RGBA
+    const unsigned char color_types[] = { 0, 4, 2, 6 };
+    std::vector<unsigned char> header;
+    appendBigEndian(header, static_cast<uint32_t>(width));
+    appendBigEndian(header, static_cast<uint32_t>(height));
+    header.insert(header.end(), { 16, color_types[channels - 1], 0, 0, 0 });
+    std::vector<unsigned char> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    appendPngChunk(png, "IHDR", header.data(), header.size());
+    appendPngChunk(png, "IDAT", compressed, static_cast<size_t>(compressed_size));
+    appendPngChunk(png, "IEND", nullptr, 0);
+    STBIW_FREE(compressed);
+
+    std::ofstream file(filename, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(png.data()), png.size());
+    return static_cast<bool>(file);
+}
+
+void freeStbiPixels(unsigned char* pixels) {
+    stbi_image_free(pixels);
+}
+
+void releasePooledPixels(unsigned char* pixels) {
+    BufferPool::instance().release(pixels);
+}
+
+bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Pixels of image with the rows one after the other, in storage unless they already are
+const unsigned char* packedPixels(const ImageView& image, std::vector<unsigned char>& storage) {
+    const size_t row_bytes = static_cast<size_t>(image.width) * image.bytesPerPixel();
+    if (image.pitch == static_cast<ptrdiff_t>(row_bytes)) {
+        return image.pixels;
+    }
+    storage.resize(row_bytes * image.height);
+    for (int y = 0; y < image.height; y++) {
+        std::copy(image.row(y), image.row(y) + row_bytes, storage.data() + y * row_bytes);
+    }
+    return storage.data();
+}
+
+} // namespace
 
-ImageData::ImageData(const std::string& filename) : ImageData() {
-    // since we read as RGBA
-    desired_channels = STBI_rgb_alpha;
-    pixels = stbi_load(filename.c_str(), &width, &height, &original_channels, desired_channels);
-    size = width * height * desired_channels;
+int channelSize(PixelFormat format) {
+    switch (format) {
+    case PixelFormat::UNorm16:
+    case PixelFormat::Float16:
+        return 2;
+    case PixelFormat::Float32:
+        return 4;
+    default:
+        return 1;
+    }
+}
+
+ImageData::ImageData(const std::string& filename, int channels, bool rgb_as_rgba) : ImageData() {
+    if (!stbi_info(filename.c_str(), &width, &height, &original_channels)) {
+        throw std::runtime_error("Failed to load image: " + filename + "!\n");
+    }
+    // Every image keeps its channels, the kernels have RGB ones of their own: no alpha to read, filter and write
+    desired_channels = channels != 0 ? channels : (original_channels == STBI_rgb && rgb_as_rgba ? STBI_rgb_alpha : original_channels);
+    if (stbi_is_hdr(filename.c_str())) {
+        // HDR images are stored as half floats: same range for lighting values at half the memory
+        float* values = stbi_loadf(filename.c_str(), &width, &height, &original_channels, desired_channels);
+        if (!values) {
+            throw std::runtime_error("Failed to load image: " + filename + "!\n");
+        }
+        format = PixelFormat::Float16;
+        allocate();
+        floatToHalfRow(values, static_cast<size_t>(width) * height * desired_channels, reinterpret_cast<uint16_t*>(pixels));
+        stbi_image_free(values);
+    } else if (stbi_is_16_bit(filename.c_str())) {
+        // 16 bit PNGs (i. e. heightmaps) keep their precision
+        format = PixelFormat::UNorm16;
+        adopt(reinterpret_cast<unsigned char*>(stbi_load_16(filename.c_str(), &width, &height, &original_channels, desired_channels)), freeStbiPixels);
+    } else {
+        adopt(stbi_load(filename.c_str(), &width, &height, &original_channels, desired_channels), freeStbiPixels);
+    }
+    pitch = width * bytesPerPixel();
+    size = static_cast<size_t>(height) * pitch;
 
     if (!pixels) {
         throw std::runtime_error("Failed to load image: " + filename + "!\n");
     }
 };
 
-ImageData::ImageData() : width(0), height(0), original_channels(0), desired_channels(0), level(0), pixels(nullptr), size(0) {
+ImageData::ImageData() : width(0), height(0), original_channels(0), desired_channels(0), level(0), format(PixelFormat::UNorm8), size(0), pitch(0),
+    pixels(nullptr), deleter(nullptr) {
    
 };
 
-ImageData::ImageData(const ImageData& to_copy) : width(to_copy.width), height(to_copy.height), original_channels(to_copy.original_channels), 
-    desired_channels(to_copy.desired_channels), level(to_copy.level), pixels(nullptr), size(0) {
+ImageData::ImageData(ImageData&& other) noexcept : width(other.width), height(other.height), original_channels(other.original_channels),
+    desired_channels(other.desired_channels), level(other.level), format(other.format), size(other.size), pitch(other.pitch),
+    pixels(other.pixels), deleter(other.deleter) {
+    other.size = 0;
+    other.pitch = 0;
+    other.pixels = nullptr;
+    other.deleter = nullptr;
+}
+
+ImageData ImageData::info() const {
+    ImageData image;
+    image.width = width;
+    image.height = height;
+    image.original_channels = original_channels;
+    image.desired_channels = desired_channels;
+    image.level = level;
+    image.format = format;
+    return image;
+}
+
+void ImageData::allocate() {
+    const size_t row_bytes = static_cast<size_t>(width) * bytesPerPixel();
+    if (row_bytes > static_cast<size_t>(std::numeric_limits<int>::max()) ||
+        (height > 0 && row_bytes > std::numeric_limits<size_t>::max() / height)) {
+        throw std::bad_alloc();
+    }
+    adopt(BufferPool::instance().allocate(height * row_bytes), releasePooledPixels);
+    pitch = static_cast<int>(row_bytes);
+    size = height * row_bytes;
+}
 
+void ImageData::adopt(unsigned char* new_pixels, PixelDeleter new_deleter) {
+    reset();
+    pixels = new_pixels;
+    deleter = new_deleter;
+}
+
+void ImageData::reset() {
+    if (deleter != nullptr && pixels != nullptr) {
+        deleter(pixels);
+    }
+    pixels = nullptr;
+    deleter = nullptr;
+    size = 0;
+    pitch = 0;
+}
+
+int ImageData::bytesPerPixel() const {
+    return desired_channels * channelSize(format);
 }
 
 bool ImageData::save(const std::string& filename) {
-    int bytes_written = stbi_write_jpg(filename.c_str(), width, height, desired_channels, pixels, /*quality=*/100);
-    return bytes_written != 0;
+    return saveImage(*this, filename);
 };
 
 std::string ImageData::print() const {
@@ -39,29 +262,57 @@ std::string ImageData::print() const {
     return info;
 }
 
-ImageData& ImageData::operator= (const ImageData& rhs) {
+ImageData& ImageData::operator= (ImageData&& rhs) noexcept {
     // Prevent self assignation
     if (this == &rhs) {
         return *this;
     }
-    
+    reset();
     width = rhs.width; 
     height = rhs.height; 
     original_channels = rhs.original_channels;
     desired_channels = rhs.desired_channels;
     level = rhs.level; 
-    // In the remote case we had previous memmory
-    if (pixels != nullptr) {
-        stbi_image_free(pixels);
-    }
-    pixels = nullptr;
-    size = 0;
+    format = rhs.format;
+    size = rhs.size;
+    pitch = rhs.pitch;
+    pixels = rhs.pixels;
+    deleter = rhs.deleter;
+    rhs.size = 0;
+    rhs.pitch = 0;
+    rhs.pixels = nullptr;
+    rhs.deleter = nullptr;
 
     return *this;
 }
 
 ImageData::~ImageData() { 
-    if (pixels != nullptr) {
-        stbi_image_free(pixels);
+    reset();
+};
+
+bool saveImage(const ImageView& image, const std::string& filename) {
+    std::vector<unsigned char> storage;
+    const unsigned char* data = packedPixels(image, storage);
+    if (image.format == PixelFormat::UNorm8) {
+        int bytes_written = stbi_write_jpg(filename.c_str(), image.width, image.height, image.channels, data, /*quality=*/100);
+        return bytes_written != 0;
     }
-};
\ No newline at end of file
+    if (image.format == PixelFormat::UNorm16) {
+        if (endsWith(filename, ".raw")) {
+            std::ofstream file(filename, std::ios::binary);
+            file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(image.height) * image.width * image.bytesPerPixel());
+            return static_cast<bool>(file);
+        }
+        return writePng16(filename, image.width, image.height, image.channels, reinterpret_cast<const uint16_t*>(data));
+    }
+    // stbi_write_hdr takes 32 bit floats (and drops alpha)
+    const size_t count = static_cast<size_t>(image.width) * image.height * image.channels;
+    std::vector<float> values;
+    const float* floats = reinterpret_cast<const float*>(data);
+    if (image.format == PixelFormat::Float16) {
+        values.resize(count);
+        halfToFloatRow(reinterpret_cast<const uint16_t*>(data), count, values.data());
+        floats = values.data();
+    }
+    return stbi_write_hdr(filename.c_str(), image.width, image.height, image.channels, floats) != 0;
+}
@@ -1,8 +1,28 @@
 #ifndef IMAGEDATA_H_
 #define IMAGEDATA_H_
 
+#include <cstddef>
 #include <string>
 
+// Type of every channel of the pixels
+enum class PixelFormat : int {
+    // 8 bit unsigned normalized (LDR images)
+    UNorm8 = 0,
+    // 16 bit unsigned normalized (heightmaps, masks)
+    UNorm16,
+    // Half float, the storage of HDR images (lightmaps, environment maps...)
+    Float16,
+    // Single float
+    Float32
+};
+
+// Bytes of a channel of format
+int channelSize(PixelFormat format);
+
+// Releases the pixels of an image
+typedef void (*PixelDeleter)(unsigned char* pixels);
+
+// Owns its pixels, so it can be moved but not copied: a level is never duplicated
 class ImageData {
 public: 
     int width;
@@ -10,17 +30,45 @@ public:
     int original_channels;
     int desired_channels;
     int level;
-    // in bytes
-    int size;
-    //pixels
+    PixelFormat format;
+    // in bytes, height * pitch. Levels of large float images take more than 2 GB
+    size_t size;
+    // Bytes from the start of a row to the start of the next one, at least width * bytesPerPixel()
+    int pitch;
+    //pixels. Released by the deleter, an image without one does not own them (i. e. it is a view of another)
     unsigned char* pixels;
     explicit ImageData();
-    explicit ImageData(const std::string& filename);
-    explicit ImageData(const ImageData& to_copy);
-    ImageData& operator= (const ImageData& rhs);
+    // Loads the image with channels channels (1 to 4). 0 keeps the channels of the file, but RGB is expanded to
+    // RGBA when rgb_as_rgba (i. e. for options that need an alpha channel)
+    explicit ImageData(const std::string& filename, int channels = 0, bool rgb_as_rgba = false);
+    ImageData(ImageData&& other) noexcept;
+    ImageData& operator= (ImageData&& rhs) noexcept;
+    ImageData(const ImageData&) = delete;
+    ImageData& operator= (const ImageData&) = delete;
+    // Image with the same size, channels, format and level, without pixels
+    ImageData info() const;
+    // Allocates the (uninitialized) pixels of width x height without padding from the BufferPool, releasing the
+    // previous ones
+    void allocate();
+    // Takes the ownership of pixels, deleter releases them
+    void adopt(unsigned char* new_pixels, PixelDeleter new_deleter);
+    // Releases the pixels
+    void reset();
+    int bytesPerPixel() const;
+    // First pixel of row y
+    unsigned char* row(int y) {
+        return pixels + static_cast<ptrdiff_t>(y) * pitch;
+    }
+    const unsigned char* row(int y) const {
+        return pixels + static_cast<ptrdiff_t>(y) * pitch;
+    }
+    // JPG for 8 bit images, PNG (or raw little endian channels if filename ends in ".raw") for 16 bit
+    // ones and Radiance HDR for float ones
     bool save(const std::string& filename);
     std::string print() const;
     ~ImageData();
+private:
+    PixelDeleter deleter;
 };
 
 #endif // HEADER_H_
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "ImageData.h"
+
+// Pixels of an image that the view does not own: a whole level, a rectangle of one (i. e. a texture of an
+// atlas or a tile of a larger buffer) or the same rows upside down. The CPU kernels read and write views,
+// so none of these cases copy pixels
+struct ImageView {
+    // First pixel of row 0
+    unsigned char* pixels{ nullptr };
+    int width{ 0 };
+    int height{ 0 };
+    int channels{ 0 };
+    PixelFormat format{ PixelFormat::UNorm8 };
+    // Bytes from the start of a row to the start of the next one, negative when the rows go up in memory
+    ptrdiff_t pitch{ 0 };
+
+    ImageView() = default;
+    // Every pixel of image
+    ImageView(const ImageData& image)
+        : pixels(image.pixels), width(image.width), height(image.height), channels(image.desired_channels),
+          format(image.format), pitch(image.pitch) {
+    }
+    int bytesPerPixel() const {
+        return channels * channelSize(format);
+    }
+    // First pixel of row y
+    unsigned char* row(int y) const {
+        return pixels + y * pitch;
+    }
+    // The width x height pixels whose top left corner is (x, y)
+    ImageView subRect(int x, int y, int rect_width, int rect_height) const {
+        ImageView rect = *this;
+        rect.pixels = row(y) + static_cast<ptrdiff_t>(x) * bytesPerPixel();
+        rect.width = rect_width;
+        rect.height = rect_height;
+        return rect;
+    }
+    // The rows in reverse order, i. e. bottom-up like OpenGL textures
+    ImageView flipped() const {
+        ImageView rows = *this;
+        rows.pixels = row(height - 1);
+        rows.pitch = -pitch;
+        return rows;
+    }
+};
+
+// Writes the pixels of image like ImageData::save, whatever its pitch
+bool saveImage(const ImageView& image, const std::string& filename);
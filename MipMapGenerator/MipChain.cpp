@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include "MipChain.h"
+
+namespace {
+
+// Sizes and offsets of chains of large images (i. e. 16K float RGBA, 4 GB for level 0) are past 32 bits:
+// they are computed in size_t, and a chain that does not even fit in it is refused
+size_t checkedAdd(size_t a, size_t b) {
+    if (a > std::numeric_limits<size_t>::max() - b) {
+        throw std::runtime_error("The mip chain is too large!");
+    }
+    return a + b;
+}
+
+size_t checkedMultiply(size_t a, size_t b) {
+    if (a != 0 && b > std::numeric_limits<size_t>::max() / a) {
+        throw std::runtime_error("The mip chain is too large!");
+    }
+    return a * b;
+}
+
+size_t alignUp(size_t value, size_t alignment) {
+    return checkedAdd(value, alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+MipChain::MipChain(const ImageData& base, int num_levels, int row_alignment, TextureLayout layout) : mLayout(layout) {
+    allocate(base, num_levels, row_alignment, false);
+}
+
+MipChain MipChain::layoutOf(const ImageData& base, int num_levels, int row_alignment, TextureLayout layout) {
+    MipChain chain;
+    chain.mLayout = layout;
+    chain.layOut(base, num_levels, row_alignment, false);
+    return chain;
+}
+
+MipChain::MipChain(ImageData&& base, int num_levels, int row_alignment, TextureLayout layout) : mLayout(layout) {
+    const size_t row_bytes = static_cast<size_t>(base.width) * base.bytesPerPixel();
+    const bool takes_base = row_alignment > 0 && base.pixels != nullptr &&
+                            static_cast<size_t>(base.pitch) == alignUp(row_bytes, row_alignment) &&
+                            reinterpret_cast<uintptr_t>(base.pixels) % kAlignment == 0;
+    allocate(base, num_levels, row_alignment, takes_base);
+    if (takes_base) {
+        mLevels[0] = std::move(base);
+        return;
+    }
+    for (int y = 0; y < base.height; y++) {
+        std::copy(base.row(y), base.row(y) + row_bytes, mLevels[0].row(y));
+    }
+    base.reset();
+}
+
+// Lays the levels out and allocates the block with them, level 0 left out of it when it is the pixels of base
+void MipChain::allocate(const ImageData& base, int num_levels, int row_alignment, bool base_level) {
+    layOut(base, num_levels, row_alignment, base_level);
+    mMemory.reset(BufferPool::instance().allocate(mBytes));
+    for (int l = 0; l < num_levels; l++) {
+        mLevels[l].pixels = l > 0 || !base_level ? mMemory.get() + mOffsets[l] : nullptr;
+        mLayoutLevels[l] = mLayout != TextureLayout::Linear ? mMemory.get() + mLayoutOffsets[l] : nullptr;
+    }
+}
+
+// Sizes of the levels, where each one starts in the block and the bytes of the block, without allocating it
+void MipChain::layOut(const ImageData& base, int num_levels, int row_alignment, bool base_level) {
+    if (num_levels < 1 || num_levels > kMaxLevels || row_alignment < 1) {
+        throw std::runtime_error("Invalid mip chain!");
+    }
+    // Size of every level (halving each side down to 1, like the GPU does) and where it starts
+    for (int l = 0; l < num_levels; l++) {
+        ImageData& level = mLevels[l];
+        level = base.info();
+        if (l > 0) {
+            const ImageData& previous = mLevels[l - 1];
+            level.width = previous.width > 1 ? previous.width / 2 : 1;
+            level.height = previous.height > 1 ? previous.height / 2 : 1;
+        }
+        level.level = base.level + l;
+        mLayoutLevels[l] = nullptr;
+        const size_t pitch = alignUp(static_cast<size_t>(level.width) * level.bytesPerPixel(), row_alignment);
+        if (pitch > static_cast<size_t>(std::numeric_limits<int>::max())) {
+            throw std::runtime_error("The mip chain is too large!");
+        }
+        level.pitch = static_cast<int>(pitch);
+        level.size = checkedMultiply(level.height, pitch);
+        mBytes = alignUp(mBytes, kAlignment);
+        mOffsets[l] = mBytes;
+        if (l > 0 || !base_level) {
+            mBytes = checkedAdd(mBytes, level.size);
+        }
+    }
+    // The levels in the layout, if it is not the linear one
+    for (int l = 0; mLayout != TextureLayout::Linear && l < num_levels; l++) {
+        const ImageData& level = mLevels[l];
+        if (!fitsLayout(mLayout, level.width, level.height)) {
+            throw std::runtime_error("The mip chain does not fit the layout!");
+        }
+        mBytes = alignUp(mBytes, kAlignment);
+        mLayoutOffsets[l] = mBytes;
+        mBytes = checkedAdd(mBytes, layoutBytes(mLayout, level.width, level.height, level.bytesPerPixel()));
+    }
+    mLevelCount = num_levels;
+}
+
+int MipChain::levels() const {
+    return mLevelCount;
+}
+
+ImageData& MipChain::operator[] (int level) {
+    return mLevels[level];
+}
+
+const ImageData& MipChain::operator[] (int level) const {
+    return mLevels[level];
+}
+
+ImageData* MipChain::data() {
+    return mLevels;
+}
+
+unsigned char* MipChain::memory() {
+    return mMemory.get();
+}
+
+size_t MipChain::bytes() const {
+    return mBytes;
+}
+
+size_t MipChain::offset(int level) const {
+    return mOffsets[level];
+}
+
+LayoutLevels MipChain::layoutLevels() const {
+    if (mLayout == TextureLayout::Linear) {
+        return LayoutLevels();
+    }
+    return { mLayout, mLayoutLevels };
+}
+
+size_t MipChain::layoutOffset(int level) const {
+    return mLayoutOffsets[level];
+}
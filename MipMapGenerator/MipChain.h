@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+#include "BufferPool.h"
+#include "ImageData.h"
+#include "TextureLayout.h"
+
+// Every level of a texture in a single block of memory, from the largest to the smallest one.
+// Levels start at multiples of kAlignment bytes and their rows are padded to the row alignment,
+// so the whole chain is one allocation that can be written or handed over as a single buffer.
+// The block comes from the BufferPool, chains of the same size reuse it.
+// A chain built from an image it can take over (i. e. the decoded file) keeps its pixels as level 0, out of
+// the block: the largest level is not copied.
+// A chain with a tiled layout also holds every level in that layout, after the linear ones: the CPU generator
+// fills them as it writes the levels (in a pass after them when it preserves the alpha coverage), and the tiled
+// ones are uploaded in one go from layoutOffset(0)
+class MipChain {
+public:
+    // Levels of a chain whose first level is 2^31 pixels wide
+    static const int kMaxLevels = 32;
+
+private:
+    PoolBlock mMemory;
+    size_t mBytes{ 0 };
+    // Fixed arrays, a chain only allocates its block
+    size_t mOffsets[kMaxLevels];
+    // Views of the levels, they do not own their pixels (but a level 0 taken from the base)
+    ImageData mLevels[kMaxLevels];
+    int mLevelCount{ 0 };
+    TextureLayout mLayout{ TextureLayout::Linear };
+    size_t mLayoutOffsets[kMaxLevels];
+    unsigned char* mLayoutLevels[kMaxLevels];
+    // Helper private methods
+    MipChain() = default;
+    void allocate(const ImageData& base, int num_levels, int row_alignment, bool base_level);
+    void layOut(const ImageData& base, int num_levels, int row_alignment, bool base_level);
+
+public:
+    // A cache line, and the widest vector the kernels load (the alignment of the pool blocks)
+    static const int kAlignment = static_cast<int>(BufferPool::kAlignment);
+    // num_levels levels, the first one with the size, channels and format of base (its pixels are not copied).
+    // Rows of row_alignment bytes (GenerateMip.hlsl buffers have no padding, 1 keeps the rows packed)
+    // Throws if a level does not fit the layout (i. e. Morton order of sizes that are not powers of two)
+    MipChain(const ImageData& base, int num_levels, int row_alignment = kAlignment, TextureLayout layout = TextureLayout::Linear);
+    // Same, with the pixels of base as level 0: they are taken over when their rows have the pitch of the
+    // chain and they start at a multiple of kAlignment (pool blocks do), and copied to the block otherwise.
+    // base is left without pixels
+    MipChain(ImageData&& base, int num_levels, int row_alignment = kAlignment, TextureLayout layout = TextureLayout::Linear);
+    // The chain MipChain(base, ...) would be, without its block: the sizes and offsets of its levels and bytes(),
+    // i. e. to know the memory a chain takes before allocating it. Its levels have no pixels
+    static MipChain layoutOf(const ImageData& base, int num_levels, int row_alignment = kAlignment,
+                             TextureLayout layout = TextureLayout::Linear);
+    MipChain(MipChain&&) = default;
+    MipChain& operator= (MipChain&&) = default;
+    int levels() const;
+    ImageData& operator[] (int level);
+    const ImageData& operator[] (int level) const;
+    // The levels, one after the other
+    ImageData* data();
+    // The block with every level, level l starts at offset(l). Without level 0 when it was taken from the base
+    unsigned char* memory();
+    size_t bytes() const;
+    size_t offset(int level) const;
+    // Where the levels go in the layout of the chain, none for a linear one
+    LayoutLevels layoutLevels() const;
+    // Level l in the tiled layout of the chain starts at layoutOffset(l), the last one ends at bytes()
+    size_t layoutOffset(int level) const;
+};
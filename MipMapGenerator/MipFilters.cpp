@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <cmath>
+
+#include "MipFilters.h"
+
+namespace {
+
+const float Pi = 3.14159265f;
+
+float saturate(float x) {
+    return std::min(std::max(x, 0.0f), 1.0f);
+}
+
+// All filtering functions assume that 'x' is normalized to [0, 1], where 1 == FilterRadius
+float filterBox(float x) {
+    return x <= 1.0f ? 1.0f : 0.0f;
+}
+
+float filterTriangle(float x) {
+    return saturate(1.0f - x);
+}
+
+float filterGaussian(float x) {
+    const float sigma = 1.0f;
+    const float g = 1.0f / std::sqrt(2.0f * 3.14159f * sigma * sigma);
+    return g * std::exp(-(x * x) / (2 * sigma * sigma));
+}
+
+float filterCubic(float x, float B, float C) {
+    float y = 0.0f;
+    const float x2 = x * x;
+    const float x3 = x * x * x;
+    if (x < 1) {
+        y = (12 - 9 * B - 6 * C) * x3 + (-18 + 12 * B + 6 * C) * x2 + (6 - 2 * B);
+    } else if (x <= 2) {
+        y = (-B - 6 * C) * x3 + (6 * B + 30 * C) * x2 + (-12 * B - 48 * C) * x + (8 * B + 24 * C);
+    }
+    return y / 6.0f;
+}
+
+float filterSinc(float x, float filterRadius) {
+    x *= filterRadius * 2.0f;
+    if (x < 0.001f) {
+        return 1.0f;
+    }
+    return std::sin(x * Pi) / (x * Pi);
+}
+
+float filterBlackmanHarris(float x) {
+    x = 1.0f - x;
+    const float a0 = 0.35875f;
+    const float a1 = 0.48829f;
+    const float a2 = 0.14128f;
+    const float a3 = 0.01168f;
+    return saturate(a0 - a1 * std::cos(Pi * x) + a2 * std::cos(2 * Pi * x) - a3 * std::cos(3 * Pi * x));
+}
+
+float filterSmoothstep(float x) {
+    // 1 - smoothstep(0, 1, x)
+    const float t = saturate(x);
+    return 1.0f - t * t * (3.0f - 2.0f * t);
+}
+
+// Position of each tap along one axis, relative to the center of the neighbourhood, in pixels
+const float kTapOffsets[3][3] = {
+    { 0.0f },
+    { -0.5f, 0.5f },
+    { -1.0f, 0.0f, 1.0f }
+};
+
+// GenerateMip.hlsl coefficients along one axis, the 2D ones are their product
+const float kBilinearWeights[3][3] = {
+    { 1.0f },
+    { 0.5f, 0.5f },
+    { 0.25f, 0.5f, 0.25f }
+};
+
+FilterKernel computeKernel(MipFilter filter, int columns, int rows) {
+    FilterKernel kernel{ columns, rows, {} };
+    if (filter == MipFilter::Bilinear) {
+        for (int j = 0; j < rows; j++) {
+            for (int i = 0; i < columns; i++) {
+                kernel.weights[j][i] = kBilinearWeights[rows - 1][j] * kBilinearWeights[columns - 1][i];
+            }
+        }
+        return kernel;
+    }
+    // Same normalization as the sampleDist tables of MipFilters.hlsl: the filter radius is half the
+    // size of the larger side of the neighbourhood (i. e. 1 for 2x2 and 1.5 when there are 3 taps)
+    const float radius = std::max(columns, rows) / 2.0f;
+    float values[3][3] = {};
+    // Normalize in double: taps at the same distance get exactly the same weight
+    // (i. e. 0.25 for any filter in the 2x2 case, like the box filter of the fused levels)
+    double total_weight = 0.0;
+    for (int j = 0; j < rows; j++) {
+        for (int i = 0; i < columns; i++) {
+            const float dx = kTapOffsets[columns - 1][i] / radius;
+            const float dy = kTapOffsets[rows - 1][j] / radius;
+            values[j][i] = filterValue(filter, std::sqrt(dx * dx + dy * dy));
+            total_weight += values[j][i];
+        }
+    }
+    // Catmull-Rom is 0 at the taps of the 2x1 and 1x2 neighbourhoods (the shader divides by 0 there).
+    // All their taps are at the same distance, so they get the same weight
+    if (total_weight == 0.0) {
+        for (int j = 0; j < rows; j++) {
+            for (int i = 0; i < columns; i++) {
+                values[j][i] = 1.0f;
+            }
+        }
+        total_weight = columns * rows;
+    }
+    for (int j = 0; j < rows; j++) {
+        for (int i = 0; i < columns; i++) {
+            kernel.weights[j][i] = static_cast<float>(values[j][i] / total_weight);
+        }
+    }
+    return kernel;
+}
+
+struct FilterKernelTable {
+    // [filter][columns - 1][rows - 1]
+    FilterKernel kernels[static_cast<int>(MipFilter::Count)][3][3];
+
+    FilterKernelTable() {
+        for (int f = 0; f < static_cast<int>(MipFilter::Count); f++) {
+            for (int columns = 1; columns <= 3; columns++) {
+                for (int rows = 1; rows <= 3; rows++) {
+                    kernels[f][columns - 1][rows - 1] = computeKernel(static_cast<MipFilter>(f), columns, rows);
+                }
+            }
+        }
+    }
+};
+
+// Radius of the direct filters in destination pixels
+const double kDirectRadius = 3.0;
+// Shape of the Kaiser window, the larger the narrower
+const double kKaiserAlpha = 4.0;
+
+double sinc(double x) {
+    if (std::abs(x) < 1e-6) {
+        return 1.0;
+    }
+    const double pi_x = 3.14159265358979323846 * x;
+    return std::sin(pi_x) / pi_x;
+}
+
+// Modified Bessel function of the first kind and order 0, by its power series
+double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32 && term > sum * 1e-12; k++) {
+        term *= (x * x) / (4.0 * k * k);
+        sum += term;
+    }
+    return sum;
+}
+
+const char* const kDirectFilterNames[] = { "lanczos", "kaiser" };
+
+const char* const kPostFilterNames[] = { "blur", "sharpen" };
+
+const char* const kFilterNames[] = {
+    "box", "triangle", "gaussian", "blackmanharris", "smoothstep",
+    "bspline", "catmullrom", "mitchell", "generalizedcubic", "sinc", "bilinear"
+};
+
+} // namespace
+
+float filterValue(MipFilter filter, float x) {
+    // Cubic filters naturually work in a [-2, 2] domain. For the resolve case we
+    // want to rescale the filter so that it works in [-1, 1] instead
+    const float cubicX = x * 2.0f;
+    switch (filter) {
+    case MipFilter::Box:
+        return filterBox(x);
+    case MipFilter::Triangle:
+        return filterTriangle(x);
+    case MipFilter::Gaussian:
+        return filterGaussian(x);
+    case MipFilter::BlackmanHarris:
+        return filterBlackmanHarris(x);
+    case MipFilter::Smoothstep:
+        return filterSmoothstep(x);
+    case MipFilter::BSpline:
+        return filterCubic(cubicX, 1.0f, 0.0f);
+    case MipFilter::CatmullRom:
+        return filterCubic(cubicX, 0.0f, 0.5f);
+    case MipFilter::Mitchell:
+        return filterCubic(cubicX, 1 / 3.0f, 1 / 3.0f);
+    case MipFilter::GeneralizedCubic:
+        return filterCubic(cubicX, 1.0f, 1.0f);
+    case MipFilter::Sinc:
+        return filterSinc(x, 1.0f);
+    default:
+        return 0.0f;
+    }
+}
+
+const FilterKernel& filterKernel(MipFilter filter, int columns, int rows) {
+    static const FilterKernelTable table;
+    return table.kernels[static_cast<int>(filter)][columns - 1][rows - 1];
+}
+
+bool filterFromName(const std::string& name, MipFilter& filter) {
+    for (int f = 0; f < static_cast<int>(MipFilter::Count); f++) {
+        if (name == kFilterNames[f]) {
+            filter = static_cast<MipFilter>(f);
+            return true;
+        }
+    }
+    return false;
+}
+
+double directFilterValue(DirectFilter filter, double x) {
+    x = std::abs(x);
+    if (x >= kDirectRadius) {
+        return 0.0;
+    }
+    switch (filter) {
+    case DirectFilter::Lanczos:
+        return sinc(x) * sinc(x / kDirectRadius);
+    case DirectFilter::Kaiser: {
+        const double t = x / kDirectRadius;
+        return sinc(x) * besselI0(kKaiserAlpha * std::sqrt(1.0 - t * t)) / besselI0(kKaiserAlpha);
+    }
+    default:
+        return 0.0;
+    }
+}
+
+AxisWeights axisWeights(DirectFilter filter, int src_size, int dst_size) {
+    // Source pixels per destination pixel. Magnifying keeps the filter at its size
+    const double ratio = static_cast<double>(src_size) / dst_size;
+    const double scale = std::max(ratio, 1.0);
+    const double support = kDirectRadius * scale;
+    // Taps of the widest window, clamped to the image: edge pixels take the weights of the taps out of it
+    int taps = 0;
+    std::vector<int> starts(dst_size);
+    for (int x = 0; x < dst_size; x++) {
+        // Source pixels whose center is within the support of the center of x
+        const double center = (x + 0.5) * ratio;
+        starts[x] = static_cast<int>(std::ceil(center - support - 0.5));
+        const int end = static_cast<int>(std::floor(center + support - 0.5));
+        taps = std::max(taps, end - starts[x] + 1);
+    }
+    const int window = taps;
+    taps = std::min(taps, src_size);
+    AxisWeights axis{ taps, std::vector<int>(dst_size), std::vector<float>(static_cast<size_t>(dst_size) * taps) };
+    std::vector<double> values(taps);
+    for (int x = 0; x < dst_size; x++) {
+        const double center = (x + 0.5) * ratio;
+        const int first = std::min(std::max(starts[x], 0), src_size - taps);
+        std::fill(values.begin(), values.end(), 0.0);
+        double total_weight = 0.0;
+        for (int k = 0; k < window; k++) {
+            const int src = starts[x] + k;
+            const double value = directFilterValue(filter, (src + 0.5 - center) / scale);
+            values[std::min(std::max(src, 0), src_size - 1) - first] += value;
+            total_weight += value;
+        }
+        axis.first[x] = first;
+        for (int k = 0; k < taps; k++) {
+            axis.weights[static_cast<size_t>(x) * taps + k] = static_cast<float>(values[k] / total_weight);
+        }
+    }
+    return axis;
+}
+
+bool directFilterFromName(const std::string& name, DirectFilter& filter) {
+    for (int f = 0; f < 2; f++) {
+        if (name == kDirectFilterNames[f]) {
+            filter = static_cast<DirectFilter>(f + 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+float defaultPostFilterStrength(PostFilter filter) {
+    return filter == PostFilter::Sharpen ? 2.0f : 1.0f;
+}
+
+FilterKernel postFilterKernel(PostFilter filter, float k) {
+    FilterKernel kernel{ 3, 3, {} };
+    for (int j = 0; j < 3; j++) {
+        for (int i = 0; i < 3; i++) {
+            if (filter == PostFilter::Blur) {
+                // 0.0625, 0.125 and 0.25 times k
+                kernel.weights[j][i] = (j == 1 ? 0.5f : 0.25f) * (i == 1 ? 0.5f : 0.25f) * k;
+            } else if (filter == PostFilter::Sharpen) {
+                kernel.weights[j][i] = (j == 1 && i == 1 ? 1.0f : -0.0625f) * k;
+            }
+        }
+    }
+    return kernel;
+}
+
+bool postFilterFromName(const std::string& name, PostFilter& filter) {
+    for (int f = 0; f < 2; f++) {
+        if (name == kPostFilterNames[f]) {
+            filter = static_cast<PostFilter>(f + 1);
+            return true;
+        }
+    }
+    return false;
+}
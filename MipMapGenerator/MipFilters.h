@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// CPU version of the filters of MipMapGenerationTextures/MipFilters.hlsl.
+// The values match filter_option in the shader. Bilinear are the fixed coefficients of GenerateMip.hlsl
+enum class MipFilter : int {
+    Box = 0,
+    Triangle,
+    Gaussian,
+    BlackmanHarris,
+    Smoothstep,
+    BSpline,
+    CatmullRom,
+    Mitchell,
+    GeneralizedCubic,
+    Sinc,
+    Bilinear,
+    Count
+};
+
+// Normalized weights of a neighbourhood of columns x rows pixels in the src texture
+// (2 along an even dimension, 3 along an odd one and 1 along a dimension of a single pixel).
+// weights[j][i] is the weight of the pixel at row j and column i of the neighbourhood
+struct FilterKernel {
+    int columns;
+    int rows;
+    float weights[3][3];
+};
+
+// filter(x) in MipFilters.hlsl, x is the distance to the center normalized to [0, 1].
+// Bilinear has fixed weights instead of a filter function (always 0)
+float filterValue(MipFilter filter, float x);
+// Weights for every filter and neighbourhood are computed once, the first time any of them is needed,
+// so the filter does not change the cost of the reduction
+const FilterKernel& filterKernel(MipFilter filter, int columns, int rows);
+// "box", "triangle", ..., "sinc", "bilinear". Returns false if the name is unknown
+bool filterFromName(const std::string& name, MipFilter& filter);
+
+// Windowed sinc filters of the levels resampled directly from level 0 (CPUMipMapOptions::direct_filter).
+// They are too wide for the 3x3 neighbourhoods: 3 lobes, that is 6 pixels of the destination level
+enum class DirectFilter : int {
+    // Every level is reduced from the previous one
+    None = 0,
+    // sinc(x) * sinc(x / 3)
+    Lanczos,
+    // sinc(x) under a Kaiser window (alpha 4), a bit less ringing than Lanczos
+    Kaiser
+};
+
+// Weights to resample an axis of src_size pixels into dst_size pixels: destination pixel x is the sum of
+// weights[x * taps + k] * src[first[x] + k] for k in [0, taps). The filter is stretched by src_size / dst_size
+// when minifying, taps out of the image go to the closest edge pixel and the weights of every pixel sum 1
+struct AxisWeights {
+    int taps;
+    std::vector<int> first;
+    std::vector<float> weights;
+};
+
+// Value of the filter at x destination pixels from the center
+double directFilterValue(DirectFilter filter, double x);
+AxisWeights axisWeights(DirectFilter filter, int src_size, int dst_size);
+// "lanczos" or "kaiser". Returns false if the name is unknown
+bool directFilterFromName(const std::string& name, DirectFilter& filter);
+
+// 3x3 filters of ComputeShaderTextureSample/Filters.hlsl, applied to every level after it is reduced
+// (CPUMipMapOptions::post_filter). Alpha is not filtered
+enum class PostFilter : int {
+    // The levels are written as reduced
+    None = 0,
+    // k * {1, 2, 1} x {1, 2, 1} / 16, weights sum k
+    Blur,
+    // k * (the pixel - 1/16 of its 8 neighbours), weights sum k / 2
+    Sharpen
+};
+
+// Strength of the CSMain of Filters.hlsl for filter, the one that keeps the brightness: 1 (blur) or 2 (sharpen)
+float defaultPostFilterStrength(PostFilter filter);
+// Weights of filter (3 x 3) with strength k
+FilterKernel postFilterKernel(PostFilter filter, float k);
+// "blur" or "sharpen". Returns false if the name is unknown
+bool postFilterFromName(const std::string& name, PostFilter& filter);
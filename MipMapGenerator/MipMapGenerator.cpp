@@ -1,77 +1,251 @@
+#include <cmath>
+#include <cstdio>
 #include <cstdlib>
-#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <utility>
 #include <vector>
 #include <algorithm>
 
 #include <string>
 
-#define STB_IMAGE_RESIZE_IMPLEMENTATION
-#include <stb_image_resize.h>
-
+#include "BufferPool.h"
 #include "ImageData.h"
+#include "ImageView.h"
+#include "MipChain.h"
+#include "TextureLayout.h"
+#include "CPUMipMapGeneration.h"
+// The GPU generator needs D3D11, on other platforms only the CPU one is available
+#ifdef _WIN32
 #include "GPUMipMapGeneration.h"
+#endif
 
 
 int calculate_max_mipmap_level(const int& width, const int& height);
 void print_levels(const ImageData& img);
-bool resize_cpu(const ImageData& src_image, ImageData& dst_image);
+std::string base_name(const std::string& path);
+std::string file_extension(PixelFormat format);
+int next_power_of_two(int size);
+bool resize_cpu(CPUMipMapGenerator& generator, const ImageView& src_image, const ImageView& dst_image);
 
 int main(int argc, char* argv[]) {
-    // Path of the input  image file
-    const std::string image_file{"textures/countryside.jpg"};
-    std::cout << "Reading file: " << image_file << std::endl;
-    // Load input image from disk
-    ImageData input{image_file};
-    // Print input's info
-    std::cout << "Input's info " << std::endl;
-    std::cout << "width: " << input.width << std::endl;
-    std::cout << "heigth: " << input.height << std::endl;
-    std::cout << "size: " << input.size << std::endl;
-    std::cout << "original channels: " << input.original_channels << std::endl;
-    std::cout << "desired channels: " << input.desired_channels << std::endl;
-    std::cout << "level: " << input.level << std::endl << std::endl;
-    
-    // How many Mipmaps do we need to generate
-    const int levels_to_generate = calculate_max_mipmap_level(input.width, input.height);
-
-    // Array of images to store the Mipmaps
-    std::vector<ImageData> mip_maps(levels_to_generate);
-    std::cout << "There are " << levels_to_generate << " mipmaps to generate..." << std::endl;
-    // I need to do a manual copy of the first one (since the assigment operator implements a shallow copy)
-    mip_maps[0] = input;
-    // deep copy
-    mip_maps[0].size = input.size;
-    mip_maps[0].pixels = new unsigned char[mip_maps[0].size];
-    std::memcpy(mip_maps[0].pixels, input.pixels, mip_maps[0].size); 
+    // Paths of the input image files, their mips are generated one after the other
+    std::vector<std::string> image_files;
+    // Use the GPU by default when it is available
+#ifdef _WIN32
+    bool use_gpu = true;
+#else
+    bool use_gpu = false;
+#endif
+    // Settings of the CPU generator
+    CPUMipMapOptions cpu_options;
+    // Scale the image up to power of two dimensions before generating the mips
+    bool power_of_two = false;
+    // Only generate the mips of a rectangle of the image (x, y, width and height), i. e. a texture of an atlas
+    bool use_region = false;
+    int region[4] = { 0, 0, 0, 0 };
+    // Write the levels bottom-up, the row order of OpenGL textures
+    bool flip = false;
+    // Also write the whole chain in a tiled layout, ready to upload, in a single file
+    TextureLayout layout = TextureLayout::Linear;
+    // Usage: MipMapGenerator [--cpu | --gpu] [--threads N] [--filter name] [--direct lanczos|kaiser] [--post-filter blur|sharpen]
+    //                        [--post-filter-k k] [--desaturate] [--tint r,g,b] [--swizzle rgba01] [--pow2] [--region x,y,w,h]
+    //                        [--flip] [--srgb] [--premultiplied] [--alpha-coverage reference] [--normal-map rgb|rg]
+    //                        [--normal-length] [--planar] [--pyramid-tiles] [--layout morton|blocks] [image_file ...]
+    for (int a = 1; a < argc; ++a) {
+        const std::string arg{ argv[a] };
+        if (arg == "--cpu") {
+            use_gpu = false;
+        } else if (arg == "--gpu") {
+            use_gpu = true;
+        } else if (arg == "--threads" && a + 1 < argc) {
+            cpu_options.num_threads = static_cast<unsigned int>(std::stoul(argv[++a]));
+        } else if (arg == "--pow2") {
+            power_of_two = true;
+        } else if (arg == "--region" && a + 1 < argc) {
+            if (std::sscanf(argv[++a], "%d,%d,%d,%d", &region[0], &region[1], &region[2], &region[3]) != 4) {
+                std::cout << "Region must be x,y,width,height: " << argv[a] << std::endl;
+                return EXIT_FAILURE;
+            }
+            use_region = true;
+        } else if (arg == "--flip") {
+            flip = true;
+        } else if (arg == "--layout" && a + 1 < argc) {
+            if (!layoutFromName(argv[++a], layout)) {
+                std::cout << "Unknown layout: " << argv[a] << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (arg == "--srgb") {
+            cpu_options.srgb = true;
+        } else if (arg == "--premultiplied") {
+            cpu_options.premultiplied_alpha = true;
+        } else if (arg == "--normal-map" && a + 1 < argc) {
+            const std::string layout{ argv[++a] };
+            cpu_options.normal_map = layout == "rg" ? NormalMap::RG : NormalMap::RGB;
+        } else if (arg == "--normal-length") {
+            cpu_options.normal_length = true;
+        } else if (arg == "--planar") {
+            cpu_options.planar_tiles = true;
+        } else if (arg == "--pyramid-tiles") {
+            cpu_options.pyramid_tiles = true;
+        } else if (arg == "--alpha-coverage" && a + 1 < argc) {
+            cpu_options.preserve_alpha_coverage = true;
+            cpu_options.alpha_reference = std::stof(argv[++a]);
+        } else if (arg == "--filter" && a + 1 < argc) {
+            if (!filterFromName(argv[++a], cpu_options.filter)) {
+                std::cout << "Unknown filter: " << argv[a] << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (arg == "--direct" && a + 1 < argc) {
+            if (!directFilterFromName(argv[++a], cpu_options.direct_filter)) {
+                std::cout << "Unknown direct filter: " << argv[a] << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (arg == "--post-filter" && a + 1 < argc) {
+            if (!postFilterFromName(argv[++a], cpu_options.post_filter)) {
+                std::cout << "Unknown post filter: " << argv[a] << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (arg == "--post-filter-k" && a + 1 < argc) {
+            cpu_options.post_filter_strength = std::stof(argv[++a]);
+        } else if (arg == "--desaturate") {
+            cpu_options.color_ops.push_back(desaturateOp());
+        } else if (arg == "--tint" && a + 1 < argc) {
+            float r = 1.0f, g = 1.0f, b = 1.0f;
+            if (std::sscanf(argv[++a], "%f,%f,%f", &r, &g, &b) != 3) {
+                std::cout << "Tint must be r,g,b: " << argv[a] << std::endl;
+                return EXIT_FAILURE;
+            }
+            cpu_options.color_ops.push_back(tintOp(r, g, b));
+        } else if (arg == "--swizzle" && a + 1 < argc) {
+            ColorOp swizzle;
+            if (!swizzleOp(argv[++a], swizzle)) {
+                std::cout << "Unknown swizzle: " << argv[a] << std::endl;
+                return EXIT_FAILURE;
+            }
+            cpu_options.color_ops.push_back(swizzle);
+        } else {
+            image_files.push_back(arg);
+        }
+    }
+    if (image_files.empty()) {
+        image_files.push_back("textures/countryside.jpg");
+    }
+#ifndef _WIN32
+    if (use_gpu) {
+        std::cout << "GPU generation is only available on Windows, using the CPU" << std::endl;
+        use_gpu = false;
+    }
+#endif
+    CPUMipMapGenerator cpuGen{ cpu_options };
+#ifdef _WIN32
+    // Only create the D3D11 device when we are going to use it
+    std::unique_ptr<GPUMipMapGenerator> gpuGen{ use_gpu ? new GPUMipMapGenerator() : nullptr };
+#endif
+    for (const std::string& image_file : image_files) {
+        std::cout << "Reading file: " << image_file << std::endl;
+        // Load input image from disk. GenerateMip.hlsl works on 8 bit RGBA pixels, the CPU keeps the channels of the file
+        // unless the options need a fourth one RGB files do not have: the alpha of the coverage or the length of RGB normals
+        const bool rgb_as_rgba = cpu_options.preserve_alpha_coverage || (cpu_options.normal_map == NormalMap::RGB && cpu_options.normal_length);
+        ImageData input{image_file, use_gpu ? 4 : 0, rgb_as_rgba};
+        bool gpu_image = use_gpu;
+        if (gpu_image && input.format != PixelFormat::UNorm8) {
+            std::cout << "GPU generation only supports 8 bit images, using the CPU" << std::endl;
+            gpu_image = false;
+        }
+        // Print input's info
+        std::cout << "Input's info " << std::endl;
+        std::cout << "width: " << input.width << std::endl;
+        std::cout << "heigth: " << input.height << std::endl;
+        std::cout << "size: " << input.size << std::endl;
+        std::cout << "original channels: " << input.original_channels << std::endl;
+        std::cout << "desired channels: " << input.desired_channels << std::endl;
+        std::cout << "bytes per pixel: " << input.bytesPerPixel() << std::endl;
+        std::cout << "level: " << input.level << std::endl << std::endl;
+
+        // Pixels the mips are generated from, a view of the input: the region is not copied out of it
+        ImageView source{ input };
+        if (use_region) {
+            if (region[0] < 0 || region[1] < 0 || region[2] < 1 || region[3] < 1 ||
+                region[0] + region[2] > input.width || region[1] + region[3] > input.height) {
+                std::cout << "The region is out of the image" << std::endl;
+                return EXIT_FAILURE;
+            }
+            source = source.subRect(region[0], region[1], region[2], region[3]);
+        }
+
+        // Size of the first level
+        ImageData base{ input.info() };
+        base.width = power_of_two ? next_power_of_two(source.width) : source.width;
+        base.height = power_of_two ? next_power_of_two(source.height) : source.height;
     
-    /* Calculate the mipmaps for the next levels */
-    GPUMipMapGenerator gpuGen;
-    const bool use_gpu = true;
-    for (unsigned int i = 1; i < static_cast<unsigned int>(levels_to_generate); ++i) {
-        // Calculate filename of this level
-        const std::string next_level_image_name{ (use_gpu ? "GPU/" : "CPU/") + std::string("countryside_level_") + std::to_string(i) + ".jpg"};
-        
-        // Prepare the struct for the new resized image. I. e. calculate the info of the next level
-        mip_maps[i].width  = mip_maps[i - 1u].width  > 1 ? mip_maps[i - 1u].width  / 2 : 1;
-        mip_maps[i].height = mip_maps[i - 1u].height > 1 ? mip_maps[i - 1u].height / 2 : 1;
-        mip_maps[i].level  = mip_maps[i - 1u].level + 1;
-        mip_maps[i].desired_channels = mip_maps[i - 1u].desired_channels;
-        mip_maps[i].original_channels = mip_maps[i - 1u].original_channels;
-        // Our desired size once we are scaled
-        mip_maps[i].size = mip_maps[i].width * mip_maps[i].height * mip_maps[i].desired_channels;
-        // Allocate memory for the new resized image
-        mip_maps[i].pixels = new unsigned char[mip_maps[i].size];
+        // How many Mipmaps do we need to generate
+        const int levels_to_generate = calculate_max_mipmap_level(base.width, base.height);
+
+        if (!fitsLayout(layout, base.width, base.height)) {
+            std::cout << "The " << layoutName(layout) << " layout needs power of two sizes (--pow2)" << std::endl;
+            return EXIT_FAILURE;
+        }
+        // Every level in a single block of memory. GenerateMip.hlsl buffers are packed, the CPU pads the rows.
+        // When the whole input is the first level, the chain takes its pixels over (or copies them if its rows do not fit)
+        const int row_alignment = gpu_image ? 1 : MipChain::kAlignment;
+        const bool resized = base.width != source.width || base.height != source.height;
+        const bool input_level = !use_region && !resized;
+        MipChain mip_maps = input_level ? MipChain{ std::move(input), levels_to_generate, row_alignment, layout }
+                                        : MipChain{ base, levels_to_generate, row_alignment, layout };
+        const LayoutLevels layout_levels{ mip_maps.layoutLevels() };
+        std::cout << "There are " << levels_to_generate << " mipmaps to generate..." << std::endl;
+        if (resized) {
+            resize_cpu(cpuGen, source, mip_maps[0]);
+            std::cout << "Resized to " << base.width << " x " << base.height << std::endl << std::endl;
+        } else if (!input_level) {
+            const size_t row_bytes = static_cast<size_t>(source.width) * source.bytesPerPixel();
+            for (int y = 0; y < source.height; y++) {
+                std::copy(source.row(y), source.row(y) + row_bytes, mip_maps[0].row(y));
+            }
+        }
+        // The chain has its own first level
+        input.reset();
+        layout_levels.store(0, mip_maps[0], 0, base.width, 0, base.height);
 
+        /* Calculate the mipmaps for the next levels */
+        const std::string image_name{ base_name(image_file) };
         // Resize the image
-        if (use_gpu) {
-            gpuGen.generateMip(mip_maps[i - 1u], mip_maps[i]);
-        } else {
-            resize_cpu(mip_maps[i - 1u], mip_maps[i]);
+#ifdef _WIN32
+        if (gpu_image) {
+            for (unsigned int i = 1; i < static_cast<unsigned int>(levels_to_generate); ++i) {
+                gpuGen->generateMip(mip_maps[i - 1u], mip_maps[i]);
+                layout_levels.store(i, mip_maps[i], 0, mip_maps[i].width, 0, mip_maps[i].height);
+            }
+        } else
+#endif
+        {
+            std::cout << "CPU kernels: " << cpuGen.kernelsName() << std::endl;
+            // The CPU builds the whole chain at once, in passes of up to four levels, and stores each tile in the
+            // layout as soon as it is filtered (the whole levels once their alpha is scaled, with --alpha-coverage)
+            cpuGen.generatePyramid(mip_maps.data(), levels_to_generate, layout_levels);
+        }
+        for (unsigned int i = 1; i < static_cast<unsigned int>(levels_to_generate); ++i) {
+            // Calculate filename of this level
+            const std::string next_level_image_name{ (gpu_image ? "GPU/" : "CPU/") + image_name + "_level_" + std::to_string(i) + file_extension(mip_maps[0].format)};
+            // Write the new image to disk
+            std::cout << mip_maps[i].print() << std::endl;
+            std::cout << "Writing file: " << next_level_image_name << (saveImage(flip ? ImageView(mip_maps[i]).flipped() : ImageView(mip_maps[i]), next_level_image_name) ? " sucessful!" : " failed!") << std::endl;
+        }
+        if (layout != TextureLayout::Linear) {
+            // Every level in the layout, one after the other
+            const std::string layout_file_name{ (gpu_image ? "GPU/" : "CPU/") + image_name + "_" + layoutName(layout) + ".bin" };
+            std::ofstream layout_file{ layout_file_name, std::ios::binary };
+            layout_file.write(reinterpret_cast<const char*>(mip_maps.memory() + mip_maps.layoutOffset(0)),
+                              static_cast<std::streamsize>(mip_maps.bytes() - mip_maps.layoutOffset(0)));
+            std::cout << "Writing file: " << layout_file_name << (layout_file ? " sucessful!" : " failed!") << std::endl;
         }
-        // Write the new image to disk
-        std::cout << mip_maps[i].print() << std::endl;
-        std::cout << "Writing file: " << next_level_image_name << (mip_maps[i].save(next_level_image_name) ? " sucessful!" : " failed!") << std::endl;
+    }
+    if (image_files.size() > 1) {
+        // The buffers of the first images are reused by the next ones of the same size
+        std::cout << "Buffers allocated for " << image_files.size() << " images: " << BufferPool::instance().systemAllocations() << std::endl;
     }
     
     return EXIT_SUCCESS;
@@ -102,9 +276,35 @@ void print_levels(const ImageData& img) {
     }
 }
 
-bool resize_cpu(const ImageData& src_image, ImageData& dst_image) {
-    stbir_resize_uint8(src_image.pixels, src_image.width, src_image.height, 0,
-                       dst_image.pixels, dst_image.width, dst_image.height, 0,
-                       dst_image.desired_channels);
-    return true;
+// File name without directories nor extension. i. e. "textures/countryside.jpg" -> "countryside"
+std::string base_name(const std::string& path) {
+    const size_t slash = path.find_last_of("/\\");
+    std::string name = (slash == std::string::npos) ? path : path.substr(slash + 1);
+    const size_t dot = name.find_last_of('.');
+    return (dot == std::string::npos) ? name : name.substr(0, dot);
+}
+
+// Extension of the files written for the levels of the format (see ImageData::save)
+std::string file_extension(PixelFormat format) {
+    switch (format) {
+    case PixelFormat::UNorm8:
+        return ".jpg";
+    case PixelFormat::UNorm16:
+        return ".png";
+    default:
+        return ".hdr";
+    }
+}
+
+// Smallest power of two >= size
+int next_power_of_two(int size) {
+    int power = 1;
+    while (power < size) {
+        power *= 2;
+    }
+    return power;
+}
+
+bool resize_cpu(CPUMipMapGenerator& generator, const ImageView& src_image, const ImageView& dst_image) {
+    return generator.resize(src_image, dst_image);
 }
\ No newline at end of file
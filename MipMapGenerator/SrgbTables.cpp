@@ -0,0 +1,47 @@
+#include <cmath>
+
+#include "SrgbTables.h"
+
+namespace {
+
+// x in [0, 1]
+double srgbToLinear(double x) {
+    return x <= 0.04045 ? x / 12.92 : std::pow((x + 0.055) / 1.055, 2.4);
+}
+
+double linearToSrgb(double x) {
+    return x <= 0.0031308 ? x * 12.92 : 1.055 * std::pow(x, 1.0 / 2.4) - 0.055;
+}
+
+struct SrgbTables {
+    float to_linear[4 * 256];
+    unsigned char to_srgb[kLinearToSrgbSize + 3] = {};
+
+    SrgbTables() {
+        for (int i = 0; i < 256; i++) {
+            to_linear[i] = static_cast<float>(255.0 * srgbToLinear(i / 255.0));
+            to_linear[256 + i] = to_linear[i];
+            to_linear[512 + i] = to_linear[i];
+            to_linear[768 + i] = static_cast<float>(i);
+        }
+        for (int i = 0; i < kLinearToSrgbSize; i++) {
+            const double srgb = 255.0 * linearToSrgb(static_cast<double>(i) / (kLinearToSrgbSize - 1));
+            to_srgb[i] = static_cast<unsigned char>(std::lround(srgb));
+        }
+    }
+};
+
+const SrgbTables& tables() {
+    static const SrgbTables tables;
+    return tables;
+}
+
+} // namespace
+
+const float* srgbToLinearTable() {
+    return tables().to_linear;
+}
+
+const unsigned char* linearToSrgbTable() {
+    return tables().to_srgb;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+// Lookup tables for the sRGB transfer function (ConvertToLinear / ConvertToSRGB in GenerateMips_CS.hlsl),
+// so gamma correct filtering does not need a pow per channel.
+// Linear values use the same [0, 255] range as the 8 bit ones
+
+// Number of entries of the linear -> sRGB table (14 bits of linear precision).
+// Adjacent entries differ by less than 0.2 in the darkest part of the curve, so the
+// encoded byte is off by one at most, and only right at the rounding boundaries
+const int kLinearToSrgbSize = 1 << 14;
+
+// Linear value of every byte of a RGBA sRGB pixel, one table per channel: [channel * 256 + byte].
+// Alpha is already linear, its table is the identity
+const float* srgbToLinearTable();
+// sRGB byte (rounded) of the linear values i * 255 / (kLinearToSrgbSize - 1).
+// It is followed by 3 padding bytes, so it can be read with 32 bit gathers
+const unsigned char* linearToSrgbTable();
@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "TextureLayout.h"
+
+namespace {
+
+const char* kLayoutNames[] = { "linear", "morton", "blocks" };
+
+// Bits of value in the even bits of the result: abcd -> 0a0b0c0d
+uint64_t spreadBits(uint32_t value) {
+    uint64_t bits = value;
+    bits = (bits | (bits << 16)) & 0x0000FFFF0000FFFFull;
+    bits = (bits | (bits << 8)) & 0x00FF00FF00FF00FFull;
+    bits = (bits | (bits << 4)) & 0x0F0F0F0F0F0F0F0Full;
+    bits = (bits | (bits << 2)) & 0x3333333333333333ull;
+    bits = (bits | (bits << 1)) & 0x5555555555555555ull;
+    return bits;
+}
+
+bool isPowerOfTwo(int size) {
+    return size > 0 && (size & (size - 1)) == 0;
+}
+
+// Bits interleaved in the Morton index of a width x height level, log2 of its shorter side
+int interleavedBits(int width, int height) {
+    int bits = 0;
+    while ((2 << bits) <= std::min(width, height)) {
+        bits++;
+    }
+    return bits;
+}
+
+// Copies count pixels. PixelBytes is 0 for the sizes without a storePixels of their own (pixel_bytes)
+template <int PixelBytes>
+void copyPixels(unsigned char* dst, const unsigned char* src, int count, size_t pixel_bytes) {
+    std::memcpy(dst, src, count * (PixelBytes != 0 ? PixelBytes : pixel_bytes));
+}
+
+// Stores the region 4 rows at a time, in squares of 4x4 pixels aligned on 4 pixels, and the pixels left out
+// of them one at a time. The layouts keep each square in 16 pixels one after the other (whole cache lines of
+// RGBA pixels) so they are written at once. index(x, y) is the index of a pixel in dst, store_square(x, y, square)
+// writes the square whose first pixel is (x, y) to its place
+template <int PixelBytes, typename Index, typename StoreSquare>
+void storeSquares(const ImageView& image, size_t pixel_bytes, bool squares, int first_column, int last_column, int first_row,
+                  int last_row, unsigned char* dst, Index index, StoreSquare store_square) {
+    const int first_square_column = std::min(last_column, (first_column + 3) & ~3);
+    const int last_square_column = std::max(first_square_column, last_column & ~3);
+    for (int y = first_row; y < last_row; ) {
+        const bool square_rows = squares && (y % 4) == 0 && y + 4 <= last_row;
+        const int rows = square_rows ? 4 : 1;
+        const int left = square_rows ? first_square_column : last_column;
+        const int right = square_rows ? last_square_column : last_column;
+        for (int row = y; row < y + rows; row++) {
+            for (int x = first_column; x < left; x++) {
+                copyPixels<PixelBytes>(dst + index(x, row) * pixel_bytes, image.row(row) + x * pixel_bytes, 1, pixel_bytes);
+            }
+            for (int x = right; x < last_column; x++) {
+                copyPixels<PixelBytes>(dst + index(x, row) * pixel_bytes, image.row(row) + x * pixel_bytes, 1, pixel_bytes);
+            }
+        }
+        for (int x = left; x < right; x += 4) {
+            store_square(x, y, dst + index(x, y) * pixel_bytes);
+        }
+        y += rows;
+    }
+}
+
+// storeRegion for pixels of PixelBytes bytes, or 0 for any size (pixel_bytes): the copies of a few pixels are
+// plain moves instead of calls to memcpy
+template <int PixelBytes>
+void storePixels(TextureLayout layout, const ImageView& image, size_t pixel_bytes, int first_column, int last_column,
+                 int first_row, int last_row, unsigned char* dst) {
+    auto pixel = [&](int x, int y) {
+        return image.row(y) + x * pixel_bytes;
+    };
+    switch (layout) {
+    case TextureLayout::Linear:
+        for (int y = first_row; y < last_row; y++) {
+            std::memcpy(dst + (static_cast<size_t>(y) * image.width + first_column) * pixel_bytes, pixel(first_column, y),
+                        (last_column - first_column) * pixel_bytes);
+        }
+        break;
+    case TextureLayout::Morton: {
+        const int bits = interleavedBits(image.width, image.height);
+        const uint32_t mask = (1u << bits) - 1;
+        auto index = [&](int x, int y) {
+            const int high = image.width > image.height ? (x >> bits) : (y >> bits);
+            return spreadBits(x & mask) | (spreadBits(y & mask) << 1) | (static_cast<uint64_t>(high) << (2 * bits));
+        };
+        // The four 2x2 quads of the square one after the other, and the two rows of each one
+        auto storeSquare = [&](int x, int y, unsigned char* square) {
+            for (int quad = 0; quad < 4; quad++) {
+                const int quad_x = x + 2 * (quad & 1);
+                const int quad_y = y + (quad & 2);
+                copyPixels<PixelBytes>(square + 4 * quad * pixel_bytes, pixel(quad_x, quad_y), 2, pixel_bytes);
+                copyPixels<PixelBytes>(square + (4 * quad + 2) * pixel_bytes, pixel(quad_x, quad_y + 1), 2, pixel_bytes);
+            }
+        };
+        // Sides of less than 4 pixels have no whole squares
+        storeSquares<PixelBytes>(image, pixel_bytes, bits >= 2, first_column, last_column, first_row, last_row, dst, index, storeSquare);
+        break;
+    }
+    case TextureLayout::Blocks4x4: {
+        const size_t blocks_per_row = (image.width + 3) / 4;
+        auto index = [&](int x, int y) {
+            return (y / 4 * blocks_per_row + x / 4) * 16 + (y % 4) * 4 + x % 4;
+        };
+        auto storeBlock = [&](int x, int y, unsigned char* block) {
+            for (int row = 0; row < 4; row++) {
+                copyPixels<PixelBytes>(block + 4 * row * pixel_bytes, pixel(x, y + row), 4, pixel_bytes);
+            }
+        };
+        storeSquares<PixelBytes>(image, pixel_bytes, true, first_column, last_column, first_row, last_row, dst, index, storeBlock);
+        // The blocks of the right and bottom edges are padded with copies of the last column and row (the
+        // clamping of BC encoders), written with the region that has them: nothing is left uninitialized
+        const int padded_width = (image.width + 3) & ~3;
+        const int padded_height = (image.height + 3) & ~3;
+        const int last_padded_column = last_column == image.width ? padded_width : last_column;
+        for (int y = first_row; last_column == image.width && y < last_row; y++) {
+            for (int x = image.width; x < padded_width; x++) {
+                copyPixels<PixelBytes>(dst + index(x, y) * pixel_bytes, pixel(image.width - 1, y), 1, pixel_bytes);
+            }
+        }
+        for (int y = image.height; last_row == image.height && y < padded_height; y++) {
+            for (int x = first_column; x < last_padded_column; x++) {
+                copyPixels<PixelBytes>(dst + index(x, y) * pixel_bytes, pixel(std::min(x, image.width - 1), image.height - 1), 1, pixel_bytes);
+            }
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+} // namespace
+
+size_t layoutBytes(TextureLayout layout, int width, int height, int pixel_bytes) {
+    if (layout == TextureLayout::Blocks4x4) {
+        return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * 16 * pixel_bytes;
+    }
+    return static_cast<size_t>(width) * height * pixel_bytes;
+}
+
+bool fitsLayout(TextureLayout layout, int width, int height) {
+    return layout != TextureLayout::Morton || (isPowerOfTwo(width) && isPowerOfTwo(height));
+}
+
+void storeRegion(TextureLayout layout, const ImageView& image, int first_column, int last_column, int first_row, int last_row,
+                 unsigned char* dst) {
+    // Every format and number of channels: 8 bit, 16 bit and half, and float pixels
+    const size_t pixel_bytes = image.bytesPerPixel();
+    switch (pixel_bytes) {
+    case 1:
+        return storePixels<1>(layout, image, pixel_bytes, first_column, last_column, first_row, last_row, dst);
+    case 2:
+        return storePixels<2>(layout, image, pixel_bytes, first_column, last_column, first_row, last_row, dst);
+    case 3:
+        return storePixels<3>(layout, image, pixel_bytes, first_column, last_column, first_row, last_row, dst);
+    case 4:
+        return storePixels<4>(layout, image, pixel_bytes, first_column, last_column, first_row, last_row, dst);
+    case 6:
+        return storePixels<6>(layout, image, pixel_bytes, first_column, last_column, first_row, last_row, dst);
+    case 8:
+        return storePixels<8>(layout, image, pixel_bytes, first_column, last_column, first_row, last_row, dst);
+    case 12:
+        return storePixels<12>(layout, image, pixel_bytes, first_column, last_column, first_row, last_row, dst);
+    case 16:
+        return storePixels<16>(layout, image, pixel_bytes, first_column, last_column, first_row, last_row, dst);
+    default:
+        return storePixels<0>(layout, image, pixel_bytes, first_column, last_column, first_row, last_row, dst);
+    }
+}
+
+bool layoutFromName(const std::string& name, TextureLayout& layout) {
+    for (int l = 0; l < static_cast<int>(TextureLayout::Count); l++) {
+        if (name == kLayoutNames[l]) {
+            layout = static_cast<TextureLayout>(l);
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* layoutName(TextureLayout layout) {
+    return kLayoutNames[static_cast<int>(layout)];
+}
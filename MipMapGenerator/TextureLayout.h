@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "ImageView.h"
+
+// Order of the pixels of a level in memory. GPUs keep textures tiled, so neighbouring pixels share cache lines
+// in both directions: the levels written in one of these layouts can be uploaded as they are
+enum class TextureLayout : int {
+    // Row after row, the layout of ImageData and MipChain
+    Linear = 0,
+    // Morton (Z) order: the bits of x and y interleaved, x in the lowest one. The levels must be powers of two,
+    // the bits of the longer side left over go above the interleaved ones
+    Morton,
+    // 4x4 blocks of pixels, the blocks row after row and the pixels of each block too (the order of BCn blocks).
+    // The sides are rounded up to whole blocks, padded with copies of the last column and row (see storeRegion)
+    Blocks4x4,
+    Count
+};
+
+// Bytes of a level of width x height pixels of pixel_bytes bytes in layout
+size_t layoutBytes(TextureLayout layout, int width, int height, int pixel_bytes);
+// Whether a level of width x height pixels can be stored in layout (Morton order needs powers of two)
+bool fitsLayout(TextureLayout layout, int width, int height);
+// Copies the pixels [first_column, last_column) x [first_row, last_row) of image to their place in dst, the whole
+// image in layout. Regions can be stored in any order, i. e. bands of rows on several threads. The padding of
+// the Blocks4x4 edge blocks gets copies of the last column and row, stored with the region that has them
+void storeRegion(TextureLayout layout, const ImageView& image, int first_column, int last_column, int first_row, int last_row,
+                 unsigned char* dst);
+// "linear", "morton" or "blocks". Returns false if the name is unknown
+bool layoutFromName(const std::string& name, TextureLayout& layout);
+const char* layoutName(TextureLayout layout);
+
+// Where the levels of a pyramid go in a layout, besides their ImageViews: level l to levels[l].
+// Nothing is stored when levels is null, nor for the levels whose pointer is null
+struct LayoutLevels {
+    TextureLayout layout{ TextureLayout::Linear };
+    unsigned char* const* levels{ nullptr };
+
+    // The same levels, starting at level first
+    LayoutLevels from(int first) const {
+        return { layout, levels != nullptr ? levels + first : nullptr };
+    }
+    bool stores(int level) const {
+        return levels != nullptr && levels[level] != nullptr;
+    }
+    // Stores a region of image, level level, when it has a destination
+    void store(int level, const ImageView& image, int first_column, int last_column, int first_row, int last_row) const {
+        if (stores(level)) {
+            storeRegion(layout, image, first_column, last_column, first_row, last_row, levels[level]);
+        }
+    }
+};
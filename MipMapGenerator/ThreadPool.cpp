@@ -0,0 +1,87 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int num_threads) {
+    if (num_threads == 0) {
+        num_threads = std::thread::hardware_concurrency();
+    }
+    // The thread calling parallelFor also works, so we need one less worker
+    for (unsigned int i = 1; i < num_threads; i++) {
+        mWorkers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mJobReady.notify_all();
+    for (std::thread& worker : mWorkers) {
+        worker.join();
+    }
+}
+
+unsigned int ThreadPool::size() const {
+    return static_cast<unsigned int>(mWorkers.size()) + 1u;
+}
+
+void ThreadPool::runTasks(const std::function<void(int)>& task, int count) {
+    // Every thread grabs the next index until there are no more
+    for (int i = mNextIndex.fetch_add(1); i < count; i = mNextIndex.fetch_add(1)) {
+        task(i);
+    }
+}
+
+void ThreadPool::workerLoop() {
+    unsigned long long last_job = 0;
+    while (true) {
+        const std::function<void(int)>* task = nullptr;
+        int count = 0;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mJobReady.wait(lock, [&] { return mStop || mJobId != last_job; });
+            if (mStop) {
+                return;
+            }
+            last_job = mJobId;
+            // We woke up too late, the job is already finished
+            if (mTask == nullptr) {
+                continue;
+            }
+            task = mTask;
+            count = mJobCount;
+            ++mBusyWorkers;
+        }
+        runTasks(*task, count);
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            --mBusyWorkers;
+        }
+        mJobDone.notify_one();
+    }
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)>& task) {
+    // Not worth waking up anybody
+    if (count <= 1 || mWorkers.empty()) {
+        for (int i = 0; i < count; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTask = &task;
+        mJobCount = count;
+        mNextIndex = 0;
+        ++mJobId;
+    }
+    mJobReady.notify_all();
+    runTasks(task, count);
+    // Wait until every worker that joined the job has left it.
+    // Workers that did not wake up in time will see the job exhausted or a newer one
+    std::unique_lock<std::mutex> lock(mMutex);
+    mJobDone.wait(lock, [&] { return mBusyWorkers == 0; });
+    mTask = nullptr;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads to split the CPU work (i. e. rows of a mip level) in chunks.
+class ThreadPool {
+private:
+    std::vector<std::thread> mWorkers;
+    std::mutex mMutex;
+    // Wakes up the workers when there is a new job or when we are shutting down
+    std::condition_variable mJobReady;
+    // Wakes up the caller of parallelFor when the last worker leaves the job
+    std::condition_variable mJobDone;
+    // Current job: task(i) for every i in [0, mJobCount)
+    const std::function<void(int)>* mTask{ nullptr };
+    int mJobCount{ 0 };
+    std::atomic<int> mNextIndex{ 0 };
+    // Increased for each job so the workers know they have something new to do
+    unsigned long long mJobId{ 0 };
+    // Workers still working on the current job
+    int mBusyWorkers{ 0 };
+    bool mStop{ false };
+    // Helper private methods
+    void workerLoop();
+    void runTasks(const std::function<void(int)>& task, int count);
+
+public:
+    // num_threads == 0 uses one thread per hardware thread
+    explicit ThreadPool(unsigned int num_threads = 0);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator= (const ThreadPool&) = delete;
+    // Number of threads working on a job, including the calling one
+    unsigned int size() const;
+    // Runs task(i) for i in [0, count) using the workers and the calling thread.
+    // Returns once all of them are done
+    void parallelFor(int count, const std::function<void(int)>& task);
+    ~ThreadPool();
+};
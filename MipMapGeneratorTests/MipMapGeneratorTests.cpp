@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#include "BufferPool.h"
+#include "CPUMipMapGeneration.h"
+#include "ImageData.h"
+#include "MipChain.h"
+#include "MipFilters.h"
+#include "TextureLayout.h"
+
+// Checks of the CPU generator that need neither image files nor a GPU. Each test prints the checks that fail,
+// main returns EXIT_FAILURE if any did
+
+namespace {
+
+int gFailures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        gFailures++;
+    }
+}
+
+const char* kFilterNames[] = { "box", "triangle", "gaussian", "blackmanharris", "smoothstep", "bspline",
+                               "catmullrom", "mitchell", "generalizedcubic", "sinc", "bilinear" };
+
+// Chain of width x height pixels with every channel of level 0 at value (a byte or a 16 bit value)
+MipChain flatChain(int width, int height, int channels, PixelFormat format, int value) {
+    ImageData base;
+    base.width = width;
+    base.height = height;
+    base.original_channels = channels;
+    base.desired_channels = channels;
+    base.format = format;
+    int levels = 1;
+    for (int size = std::max(width, height); size > 1; size /= 2) {
+        levels++;
+    }
+    MipChain chain{ base, levels };
+    for (int y = 0; y < height; y++) {
+        for (int i = 0; i < width * channels; i++) {
+            if (format == PixelFormat::UNorm16) {
+                reinterpret_cast<uint16_t*>(chain[0].row(y))[i] = static_cast<uint16_t>(value);
+            } else {
+                chain[0].row(y)[i] = static_cast<unsigned char>(value);
+            }
+        }
+    }
+    return chain;
+}
+
+// First level of chain with a channel that is not value, -1 if there is none
+int firstLevelNotFlat(const MipChain& chain, int value) {
+    for (int l = 1; l < chain.levels(); l++) {
+        const ImageData& level = chain[l];
+        for (int y = 0; y < level.height; y++) {
+            for (int i = 0; i < level.width * level.desired_channels; i++) {
+                const int channel = level.format == PixelFormat::UNorm16 ? reinterpret_cast<const uint16_t*>(level.row(y))[i]
+                                                                         : level.row(y)[i];
+                if (channel != value) {
+                    return l;
+                }
+            }
+        }
+    }
+    return -1;
+}
+
+// The weights of every MipFilter sum 1, and the filtered values are rounded when they are written (the UNORM
+// targets of the shaders round too): a flat image stays flat down the chain. The odd sizes have 3 tap axes
+void testFlatImages8() {
+    for (int f = 0; f < static_cast<int>(MipFilter::Count); f++) {
+        CPUMipMapOptions options;
+        options.filter = static_cast<MipFilter>(f);
+        CPUMipMapGenerator generator{ options };
+        for (int channels = 1; channels <= 4; channels++) {
+            for (int value : { 1, 128, 254 }) {
+                MipChain chain = flatChain(333, 257, channels, PixelFormat::UNorm8, value);
+                generator.generatePyramid(chain.data(), chain.levels());
+                const int level = firstLevelNotFlat(chain, value);
+                check(level < 0, std::string("flat 8 bit image, ") + kFilterNames[f] + ", " + std::to_string(channels) +
+                                 " channels, value " + std::to_string(value) + ": level " + std::to_string(level));
+            }
+        }
+    }
+}
+
+// Same for 16 bit images (heightmaps, masks), whose filters keep 65536 values
+void testFlatImages16() {
+    for (int f = 0; f < static_cast<int>(MipFilter::Count); f++) {
+        CPUMipMapOptions options;
+        options.filter = static_cast<MipFilter>(f);
+        CPUMipMapGenerator generator{ options };
+        for (int channels = 1; channels <= 4; channels++) {
+            for (int value : { 1, 30000, 65534 }) {
+                MipChain chain = flatChain(333, 257, channels, PixelFormat::UNorm16, value);
+                generator.generatePyramid(chain.data(), chain.levels());
+                const int level = firstLevelNotFlat(chain, value);
+                check(level < 0, std::string("flat 16 bit image, ") + kFilterNames[f] + ", " + std::to_string(channels) +
+                                 " channels, value " + std::to_string(value) + ": level " + std::to_string(level));
+            }
+        }
+    }
+}
+
+// A 16K x 16K float RGBA chain takes 5.3 GB, 4 GB of them for level 0: its sizes and offsets are past 32 bits.
+// The chain is only laid out (MipChain::layoutOf), nothing is allocated
+void testLargeChainLayout() {
+    ImageData base;
+    base.width = 16384;
+    base.height = 16384;
+    base.original_channels = 4;
+    base.desired_channels = 4;
+    base.format = PixelFormat::Float32;
+    const int levels = 15;
+    const size_t level0_size = static_cast<size_t>(16384) * 16384 * 16;
+    const int alignment = MipChain::kAlignment;
+    if (sizeof(size_t) < 8) {
+        // It does not fit in the address space of 32 bit builds, they must refuse it
+        bool refused = false;
+        try {
+            MipChain::layoutOf(base, levels);
+        } catch (const std::runtime_error&) {
+            refused = true;
+        }
+        check(refused, "large chain refused by a 32 bit build");
+        return;
+    }
+    for (TextureLayout layout : { TextureLayout::Linear, TextureLayout::Morton, TextureLayout::Blocks4x4 }) {
+        const MipChain chain = MipChain::layoutOf(base, levels, alignment, layout);
+        const std::string name = std::string("large chain, ") + layoutName(layout) + ": ";
+        check(chain[0].size == level0_size, name + "size of level 0 " + std::to_string(chain[0].size));
+        // Each level right after the previous one (rows padded to the alignment), then the ones in the layout
+        size_t end = 0;
+        for (int l = 0; l < levels; l++) {
+            const int pitch = std::max(alignment, chain[l].width * 16);
+            check(chain[l].pitch == pitch && chain[l].size == static_cast<size_t>(chain[l].height) * pitch,
+                  name + "size of level " + std::to_string(l));
+            check(chain.offset(l) == end, name + "offset of level " + std::to_string(l) + " " + std::to_string(chain.offset(l)));
+            check(chain[l].pixels == nullptr, name + "pixels of level " + std::to_string(l));
+            end = chain.offset(l) + chain[l].size;
+        }
+        for (int l = 0; layout != TextureLayout::Linear && l < levels; l++) {
+            end = (end + alignment - 1) / alignment * alignment;
+            check(chain.layoutOffset(l) == end, name + "layout offset of level " + std::to_string(l));
+            end = chain.layoutOffset(l) + layoutBytes(layout, chain[l].width, chain[l].height, 16);
+        }
+        check(chain.bytes() == end, name + "bytes " + std::to_string(chain.bytes()));
+        check(chain.bytes() > (layout == TextureLayout::Linear ? 5 : 10) * (size_t(1) << 30), name + "bytes past 5 GB");
+    }
+}
+
+// Requests past the largest size class of the pool, up to the whole of size_t, are refused at once
+void testHugeAllocations() {
+    const size_t largest_class = size_t(1) << (sizeof(size_t) > 4 ? 40 : 31);
+    const size_t top_bit = size_t(1) << (sizeof(size_t) * 8 - 1);
+    const size_t sizes[] = { largest_class + 1, top_bit, top_bit + 5, std::numeric_limits<size_t>::max() };
+    for (size_t bytes : sizes) {
+        bool refused = false;
+        try {
+            BufferPool::instance().release(BufferPool::instance().allocate(bytes));
+        } catch (const std::bad_alloc&) {
+            refused = true;
+        }
+        check(refused, "allocation of " + std::to_string(bytes) + " bytes refused");
+    }
+}
+
+} // namespace
+
+int main() {
+    testFlatImages8();
+    testFlatImages16();
+    testLargeChainLayout();
+    testHugeAllocations();
+    std::cout << (gFailures == 0 ? "All tests passed" : std::to_string(gFailures) + " checks failed") << std::endl;
+    return gFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}